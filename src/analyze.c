@@ -0,0 +1,224 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>      /* clock_gettime */
+#include <unistd.h>    /* sysconf */
+#include <pthread.h>   /* pthread_create, pthread_join */
+#include <stdatomic.h> /* atomic_fetch_add */
+
+#include "defines.h"
+#include "rng.h"
+#include "board.h"
+#include "analyze.h"
+
+/**
+ * @def BOARDS_PER_CHUNK
+ * @brief Number of consecutive boards claimed by a thread at once
+ */
+#define BOARDS_PER_CHUNK 256
+
+/**
+ * @enum metrics
+ * @brief Histograms computed for each board
+ */
+enum metrics {
+    METRIC_3BV          = 0, /* Minimum clicks needed to solve the board */
+    METRIC_OPENINGS     = 1, /* Number of connected regions of empty tiles */
+    METRIC_OPENING_SIZE = 2, /* Tiles revealed by each opening */
+    METRIC_ISOLATED     = 3, /* Numbers that are not next to an opening */
+    METRIC_NUM          = 4,
+};
+
+/**
+ * @var metric_names
+ * @brief Name of each metric in the CSV output
+ */
+static const char* metric_names[METRIC_NUM] = {
+    [METRIC_3BV]          = "3bv",
+    [METRIC_OPENINGS]     = "openings",
+    [METRIC_OPENING_SIZE] = "opening_size",
+    [METRIC_ISOLATED]     = "isolated",
+};
+
+/**
+ * @struct Worker
+ * @brief Thread-local state of analyze_boards()
+ */
+typedef struct {
+    const AnalyzeOpts* opts;
+    atomic_uint_fast64_t* next; /* Next board index that has not been claimed */
+    uint64_t* hist[METRIC_NUM]; /* Histograms, with w * h + 1 bins each */
+    Openings openings;          /* Count plane and openings of the board */
+    bool error;                 /* True if the thread ran out of memory */
+    pthread_t thread;
+} Worker;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Fills the count plane of a board like generate_grid() in main.c
+ * @details Bombs are placed at random positions, leaving a margin around a
+ * random first reveal. If the options are stateless, each tile has a bomb
+ * depending on the seed instead.
+ * @param[in] w Thread state
+ * @param[in] board Index of the board
+ */
+static void generate_board(Worker* w, uint64_t board) {
+    const int width  = w->opts->w;
+    const int height = w->opts->h;
+
+    /* Counter-based stream, so each board only depends on its index */
+    const uint64_t board_seed = w->opts->seed + board;
+    uint64_t ctr              = splitmix64(board_seed);
+    const int start_x         = splitmix64(ctr++) % width;
+    const int start_y         = splitmix64(ctr++) % height;
+
+    if (w->opts->stateless)
+        board_stateless_bombs(w->openings.counts, width, height, start_x,
+                              start_y, w->opts->bomb_percent, board_seed);
+    else
+        board_random_bombs(w->openings.counts, width, height, start_x,
+                           start_y, w->opts->bomb_percent, ctr);
+}
+
+/**
+ * @brief Computes the metrics of the board in the count plane
+ * @details Uses the same openings and 3BV as the game (see board_openings()).
+ * @param[inout] w Thread state, the histograms will be updated
+ * @return False if there was not enough memory
+ */
+static bool analyze_board(Worker* w) {
+    Openings* openings = &w->openings;
+    if (!board_openings(openings, w->opts->w, w->opts->h))
+        return false;
+
+    for (uint32_t i = 0; i < openings->num; i++)
+        w->hist[METRIC_OPENING_SIZE]
+               [openings->start[i + 1] - openings->start[i]]++;
+
+    w->hist[METRIC_3BV][openings->bbbv]++;
+    w->hist[METRIC_OPENINGS][openings->num]++;
+    w->hist[METRIC_ISOLATED][openings->bbbv - openings->num]++;
+    return true;
+}
+
+/**
+ * @brief Thread entry point, analyzes boards until there are none left
+ * @param[inout] arg Pointer to the Worker of this thread
+ */
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+
+    for (;;) {
+        const uint64_t first = atomic_fetch_add(w->next, BOARDS_PER_CHUNK);
+        if (first >= w->opts->boards)
+            break;
+
+        uint64_t last = first + BOARDS_PER_CHUNK;
+        if (last > w->opts->boards)
+            last = w->opts->boards;
+
+        for (uint64_t board = first; board < last; board++) {
+            generate_board(w, board);
+            if (!analyze_board(w)) {
+                w->error = true;
+                return NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Frees the buffers of a worker
+ */
+static void worker_free(Worker* w) {
+    for (int m = 0; m < METRIC_NUM; m++)
+        free(w->hist[m]);
+
+    openings_free(&w->openings);
+}
+
+/*----------------------------------------------------------------------------*/
+
+bool analyze_boards(const AnalyzeOpts* opts, FILE* out) {
+    const size_t tiles = (size_t)opts->w * opts->h;
+
+    long threads_num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads_num < 1)
+        threads_num = 1;
+
+    Worker* workers = calloc(threads_num, sizeof(Worker));
+    if (workers == NULL)
+        return false;
+
+    atomic_uint_fast64_t next = 0;
+    bool ret                  = true;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long started = 0;
+    for (; started < threads_num; started++) {
+        Worker* w = &workers[started];
+        w->opts   = opts;
+        w->next   = &next;
+
+        bool alloc_error = !openings_alloc(&w->openings, opts->w, opts->h);
+        for (int m = 0; m < METRIC_NUM; m++) {
+            w->hist[m] = calloc(tiles + 1, sizeof(uint64_t));
+            alloc_error |= w->hist[m] == NULL;
+        }
+
+        if (alloc_error || pthread_create(&w->thread, NULL, worker_main, w)) {
+            worker_free(w);
+            ret = false;
+            break;
+        }
+    }
+
+    /* Merge the histograms into the ones of the first worker */
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].error)
+            ret = false;
+
+        if (i == 0)
+            continue;
+
+        for (int m = 0; m < METRIC_NUM; m++)
+            for (size_t v = 0; v <= tiles; v++)
+                workers[0].hist[m][v] += workers[i].hist[m][v];
+
+        worker_free(&workers[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (ret) {
+        fprintf(out, "metric,value,count\n");
+        for (int m = 0; m < METRIC_NUM; m++)
+            for (size_t v = 0; v <= tiles; v++)
+                if (workers[0].hist[m][v] > 0)
+                    fprintf(out, "%s,%zu,%llu\n", metric_names[m], v,
+                            (unsigned long long)workers[0].hist[m][v]);
+
+        const double secs = (end.tv_sec - start.tv_sec) +
+                            (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+        fprintf(stderr, "Analyzed %llu boards in %.2fs with %ld threads "
+                        "(%.0f boards/s)\n",
+                (unsigned long long)opts->boards, secs, threads_num,
+                opts->boards / secs);
+    }
+
+    if (started > 0)
+        worker_free(&workers[0]);
+
+    free(workers);
+    return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef _ANALYZE_H
+#define _ANALYZE_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @struct AnalyzeOpts
+ * @brief Options for analyze_boards()
+ */
+typedef struct {
+    uint16_t w, h;    /* Width and height of each board */
+    int bomb_percent; /* Percentage of bombs, from DIFFIC2BOMBPERCENT */
+    uint64_t boards;  /* Number of boards to analyze */
+    bool stateless;   /* Generate the boards like `--seed` does */
+    uint64_t seed;    /* Seed of the first board. Board N uses seed + N */
+} AnalyzeOpts;
+
+/**
+ * @brief Generates and analyzes boards using all the available cores
+ * @details Computes the 3BV, the number and size of the openings and the number
+ * of isolated numbers of each board, and writes their histograms to `out` in
+ * CSV format, with a `metric,value,count` header. The results only depend on
+ * the options, not on the number of threads.
+ * @param[in] opts Board options
+ * @param[out] out File where the CSV will be written
+ * @return False on error
+ */
+bool analyze_boards(const AnalyzeOpts* opts, FILE* out);
+
+#endif /* _ANALYZE_H */
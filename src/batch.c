@@ -0,0 +1,467 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>    /* clock_gettime */
+#include <unistd.h>  /* sysconf */
+#include <pthread.h> /* pthread_create, pthread_join */
+
+#include "defines.h"
+#include "rng.h"
+#include "batch.h"
+
+/**
+ * @struct BenchWorker
+ * @brief Thread-local state of batch_bench()
+ */
+typedef struct {
+    const BatchOpts* opts;
+    uint64_t steps;  /* Calls to batch_step() */
+    uint64_t seed;   /* Seed of the environment of this thread */
+    uint64_t games;  /* Number of finished games */
+    uint64_t wins;   /* Number of won games */
+    bool ok;         /* False if there was not enough memory */
+    pthread_t thread;
+} BenchWorker;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Returns a row with the bits of all the tiles in the board set
+ */
+static inline uint64_t row_mask(const BatchEnv* env) {
+    return (env->opts.w == 64) ? UINT64_MAX : (1ULL << env->opts.w) - 1;
+}
+
+/**
+ * @brief Returns the tiles of a row that are next to or in `row`
+ */
+static inline uint64_t spread(uint64_t row, uint64_t mask) {
+    return (row | row << 1 | row >> 1) & mask;
+}
+
+/**
+ * @brief Returns the bitwise OR of a row and the rows above and bellow it
+ * @param[in] rows Bitboard of a single board
+ * @param[in] h Number of rows
+ * @param[in] y Row in the middle
+ */
+static inline uint64_t rows_around(const uint64_t* rows, int h, int y) {
+    uint64_t ret = rows[y];
+
+    if (y > 0)
+        ret |= rows[y - 1];
+    if (y < h - 1)
+        ret |= rows[y + 1];
+
+    return ret;
+}
+
+/**
+ * @brief Hides all the tiles of a board
+ * @details The bombs are not cleared, they are only read once the board is
+ * started, and place_bombs() overwrites them.
+ */
+static void clear_board(BatchEnv* env, uint32_t b) {
+    const int h        = env->opts.h;
+    const size_t tiles = (size_t)env->opts.w * h;
+
+    memset(&env->revealed[b * h], 0, h * sizeof(uint64_t));
+    memset(&env->flagged[b * h], 0, h * sizeof(uint64_t));
+    memset(&env->obs[b * tiles], OBS_HIDDEN, tiles);
+
+    env->started[b] = false;
+}
+
+/**
+ * @brief Places the bombs of a board, like generate_grid() with `--seed`
+ * @details Leaves the BOMB_MARGIN zone around the first reveal empty, and
+ * computes the tiles without bombs around them.
+ * @param[inout] env Environment
+ * @param[in] b Index of the board
+ * @param[in] start_x, start_y Position of the first reveal
+ */
+static void place_bombs(BatchEnv* env, uint32_t b, int start_x, int start_y) {
+    const int w         = env->opts.w;
+    const int h         = env->opts.h;
+    const uint64_t mask = row_mask(env);
+    uint64_t* bombs     = &env->bombs[b * h];
+    uint64_t* empty     = &env->empty[b * h];
+
+    int bomb_num = 0;
+    for (int y = 0; y < h; y++) {
+        uint64_t row = 0;
+
+        for (int x = 0; x < w; x++) {
+            /* Leave an empty zone around the first reveal */
+            if (in_safe_zone(x, y, start_x, start_y))
+                continue;
+
+            if (stateless_bomb(env->seeds[b], x, y, env->opts.bomb_percent))
+                row |= 1ULL << x;
+        }
+
+        bombs[y] = row;
+        bomb_num += __builtin_popcountll(row);
+    }
+
+    /* A tile is empty if there are no bombs in its 3x3 area */
+    for (int y = 0; y < h; y++)
+        empty[y] = mask & ~spread(rows_around(bombs, h, y), mask);
+
+    env->safe[b]      = w * h - bomb_num;
+    env->safe_left[b] = env->safe[b];
+    env->started[b]   = true;
+}
+
+/**
+ * @brief Reveals tiles of a row that don't have bombs, and writes their
+ * observations
+ * @param[inout] env Environment
+ * @param[in] b Index of the board
+ * @param[in] y Row of the tiles
+ * @param[in] bits Tiles of the row to reveal, they must be hidden
+ * @return Number of revealed tiles
+ */
+static int reveal_bits(BatchEnv* env, uint32_t b, int y, uint64_t bits) {
+    const int w           = env->opts.w;
+    const int h           = env->opts.h;
+    const uint64_t* bombs = &env->bombs[b * h];
+    uint8_t* obs          = &env->obs[(size_t)b * w * h + y * w];
+
+    env->revealed[b * h + y] |= bits;
+    env->flagged[b * h + y] &= ~bits;
+
+    const int ret = __builtin_popcountll(bits);
+
+    /* The number of each tile is the bombs in the 3 rows around it */
+    while (bits != 0) {
+        const int x         = __builtin_ctzll(bits);
+        const uint64_t area = spread(1ULL << x, UINT64_MAX);
+
+        int count = __builtin_popcountll(bombs[y] & area);
+        if (y > 0)
+            count += __builtin_popcountll(bombs[y - 1] & area);
+        if (y < h - 1)
+            count += __builtin_popcountll(bombs[y + 1] & area);
+
+        obs[x] = count;
+        bits &= bits - 1;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Reveals a tile of a board, and the whole opening if it's empty
+ * @details The opening is filled on whole rows at once: each pass adds the
+ * empty tiles next to the opening in the rows above and bellow, until no row
+ * changes. Then, the tiles around the opening are revealed.
+ * @param[inout] env Environment
+ * @param[in] b Index of the board
+ * @param[in] x, y Position of the tile
+ * @return Number of revealed tiles, or -1 if the tile had a bomb
+ */
+static int reveal(BatchEnv* env, uint32_t b, int x, int y) {
+    const int h           = env->opts.h;
+    const uint64_t mask   = row_mask(env);
+    const uint64_t bit    = 1ULL << x;
+    const uint64_t* empty = &env->empty[b * h];
+    const uint64_t* known = &env->revealed[b * h];
+    uint64_t* region      = env->region;
+
+    if (known[y] & bit)
+        return 0;
+
+    if (env->bombs[b * h + y] & bit) {
+        env->revealed[b * h + y] |= bit;
+        env->obs[(size_t)b * env->opts.w * h + y * env->opts.w + x] = OBS_BOMB;
+        return -1;
+    }
+
+    /* A number only reveals itself */
+    if (!(empty[y] & bit))
+        return reveal_bits(env, b, y, bit);
+
+    memset(region, 0, h * sizeof(uint64_t));
+    region[y] = bit;
+
+    /* Go down and then up, so most openings only need a few passes */
+    bool changed;
+    do {
+        changed = false;
+
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < h; i++) {
+                const int row = pass ? h - 1 - i : i;
+
+                uint64_t cur = region[row] |
+                               (spread(rows_around(region, h, row), mask) &
+                                empty[row]);
+
+                /* Grow horizontally until the row doesn't change */
+                uint64_t next;
+                while ((next = cur | (spread(cur, mask) & empty[row])) != cur)
+                    cur = next;
+
+                if (cur != region[row]) {
+                    region[row] = cur;
+                    changed     = true;
+                }
+            }
+        }
+    } while (changed);
+
+    /* The opening and its border. There can't be bombs next to an empty tile,
+     * and the hidden ones are only the tiles that were not revealed before. */
+    int ret = 0;
+    for (int row = 0; row < h; row++) {
+        const uint64_t bits =
+          spread(rows_around(region, h, row), mask) & ~known[row];
+        if (bits != 0)
+            ret += reveal_bits(env, b, row, bits);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Toggles the flag of a hidden tile
+ * @details Like in the game, tiles can't be flagged before the first reveal.
+ */
+static void toggle_flag(BatchEnv* env, uint32_t b, int x, int y) {
+    const int h        = env->opts.h;
+    const uint64_t bit = 1ULL << x;
+
+    if (!env->started[b] || (env->revealed[b * h + y] & bit))
+        return;
+
+    env->flagged[b * h + y] ^= bit;
+    env->obs[(size_t)b * env->opts.w * h + y * env->opts.w + x] =
+      (env->flagged[b * h + y] & bit) ? OBS_FLAG : OBS_HIDDEN;
+}
+
+/*----------------------------------------------------------------------------*/
+
+BatchEnv* batch_create(const BatchOpts* opts) {
+    if (opts->w == 0 || opts->w > BATCH_MAX_W || opts->h == 0 ||
+        opts->boards == 0)
+        return NULL;
+
+    BatchEnv* env = calloc(1, sizeof(BatchEnv));
+    if (env == NULL)
+        return NULL;
+
+    env->opts = *opts;
+
+    const size_t boards = opts->boards;
+    const size_t words  = boards * opts->h;
+
+    env->bombs     = malloc(words * sizeof(uint64_t));
+    env->empty     = malloc(words * sizeof(uint64_t));
+    env->revealed  = malloc(words * sizeof(uint64_t));
+    env->flagged   = malloc(words * sizeof(uint64_t));
+    env->region    = malloc(opts->h * sizeof(uint64_t));
+    env->seeds     = malloc(boards * sizeof(uint64_t));
+    env->safe      = malloc(boards * sizeof(uint16_t));
+    env->safe_left = malloc(boards * sizeof(uint16_t));
+    env->started   = malloc(boards);
+    env->obs       = malloc(boards * opts->w * opts->h);
+    env->rewards   = calloc(boards, sizeof(float));
+    env->dones     = calloc(boards, 1);
+
+    if (env->bombs == NULL || env->empty == NULL || env->revealed == NULL ||
+        env->flagged == NULL || env->region == NULL || env->seeds == NULL ||
+        env->safe == NULL || env->safe_left == NULL || env->started == NULL ||
+        env->obs == NULL || env->rewards == NULL || env->dones == NULL) {
+        batch_destroy(env);
+        return NULL;
+    }
+
+    /* Board B plays the games with seeds opts->seed + B + N * boards */
+    for (uint32_t b = 0; b < opts->boards; b++) {
+        env->seeds[b] = opts->seed + b;
+        clear_board(env, b);
+    }
+
+    return env;
+}
+
+void batch_destroy(BatchEnv* env) {
+    free(env->bombs);
+    free(env->empty);
+    free(env->revealed);
+    free(env->flagged);
+    free(env->region);
+    free(env->seeds);
+    free(env->safe);
+    free(env->safe_left);
+    free(env->started);
+    free(env->obs);
+    free(env->rewards);
+    free(env->dones);
+    free(env);
+}
+
+void batch_reset(BatchEnv* env, uint32_t board) {
+    env->seeds[board] += env->opts.boards;
+    clear_board(env, board);
+}
+
+void batch_step(BatchEnv* env, const ShmAction* actions) {
+    for (uint32_t b = 0; b < env->opts.boards; b++) {
+        const ShmAction* action = &actions[b];
+
+        env->rewards[b] = 0.f;
+        env->dones[b]   = false;
+
+        if (action->type == SHM_NEW_GAME) {
+            batch_reset(env, b);
+            env->dones[b] = true;
+            continue;
+        }
+
+        if (action->x >= env->opts.w || action->y >= env->opts.h)
+            continue;
+
+        if (action->type == SHM_FLAG) {
+            toggle_flag(env, b, action->x, action->y);
+            continue;
+        } else if (action->type != SHM_REVEAL) {
+            continue;
+        }
+
+        /* Place the bombs once we reveal for the first time */
+        if (!env->started[b])
+            place_bombs(env, b, action->x, action->y);
+
+        const int revealed = reveal(env, b, action->x, action->y);
+        if (revealed < 0) {
+            env->rewards[b] = -1.f;
+            env->dones[b]   = true;
+        } else {
+            env->safe_left[b] -= revealed;
+            env->rewards[b] = (float)revealed / env->safe[b];
+            env->dones[b]   = env->safe_left[b] == 0;
+        }
+
+        if (env->dones[b])
+            batch_reset(env, b);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Thread entry point of batch_bench(), steps its own environment
+ * @param[inout] arg Pointer to the BenchWorker of this thread
+ */
+static void* bench_main(void* arg) {
+    BenchWorker* w = arg;
+
+    BatchOpts opts = *w->opts;
+    opts.seed      = w->seed;
+
+    const size_t tiles = (size_t)opts.w * opts.h;
+    BatchEnv* env      = batch_create(&opts);
+    ShmAction* actions = malloc(opts.boards * sizeof(ShmAction));
+    if (env == NULL || actions == NULL) {
+        if (env != NULL)
+            batch_destroy(env);
+        free(actions);
+        return NULL;
+    }
+
+    uint64_t ctr = w->seed;
+    for (uint64_t step = 0; step < w->steps; step++) {
+        /* Random hidden tile, starting from a random one */
+        for (uint32_t b = 0; b < opts.boards; b++) {
+            const uint8_t* obs = &env->obs[b * tiles];
+
+            size_t idx = splitmix64(ctr++) % tiles;
+            while (obs[idx] != OBS_HIDDEN)
+                idx = (idx + 1 < tiles) ? idx + 1 : 0;
+
+            actions[b] = (ShmAction){
+                .x    = idx % opts.w,
+                .y    = idx / opts.w,
+                .type = SHM_REVEAL,
+            };
+        }
+
+        batch_step(env, actions);
+
+        for (uint32_t b = 0; b < opts.boards; b++) {
+            w->games += env->dones[b];
+            w->wins += env->dones[b] && env->rewards[b] > 0.f;
+        }
+    }
+
+    batch_destroy(env);
+    free(actions);
+
+    w->ok = true;
+    return NULL;
+}
+
+bool batch_bench(const BatchOpts* opts, uint64_t steps, FILE* out) {
+    if (opts->w > BATCH_MAX_W)
+        return false;
+
+    long threads_num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads_num < 1)
+        threads_num = 1;
+
+    BenchWorker* workers = calloc(threads_num, sizeof(BenchWorker));
+    if (workers == NULL)
+        return false;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long started = 0;
+    for (; started < threads_num; started++) {
+        BenchWorker* w = &workers[started];
+        w->opts        = opts;
+        w->steps       = steps;
+        w->seed        = opts->seed + splitmix64(started);
+
+        if (pthread_create(&w->thread, NULL, bench_main, w))
+            break;
+    }
+
+    bool ret       = started > 0;
+    uint64_t games = 0;
+    uint64_t wins  = 0;
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+
+        ret &= workers[i].ok;
+        games += workers[i].games;
+        wins += workers[i].wins;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (ret) {
+        const double secs = (end.tv_sec - start.tv_sec) +
+                            (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+        const uint64_t env_steps = (uint64_t)started * steps * opts->boards;
+
+        fprintf(out,
+                "Stepped %llu boards of %dx%d %llu times in %.2fs with %ld "
+                "threads\n"
+                "Env-steps per second: %.0f\n"
+                "Games: %llu (%.2f%% won)\n",
+                (unsigned long long)started * opts->boards, opts->w, opts->h,
+                (unsigned long long)steps, secs, started, env_steps / secs,
+                (unsigned long long)games,
+                games ? 100.0 * wins / games : 0.0);
+    }
+
+    free(workers);
+    return ret;
+}
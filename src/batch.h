@@ -0,0 +1,101 @@
+#ifndef _BATCH_H
+#define _BATCH_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "shm.h" /* obs_values, shm_action_types, ShmAction */
+
+/**
+ * @def BATCH_MAX_W
+ * @brief Maximum width of the boards, each row is stored in a single word
+ */
+#define BATCH_MAX_W 64
+
+/**
+ * @struct BatchOpts
+ * @brief Options for batch_create()
+ */
+typedef struct {
+    uint8_t w, h;     /* Width and height of each board */
+    int bomb_percent; /* Percentage of bombs, from DIFFIC2BOMBPERCENT */
+    uint32_t boards;  /* Number of boards stepped by each call */
+    uint64_t seed;    /* Seed of the first game of board 0 */
+} BatchOpts;
+
+/**
+ * @struct BatchEnv
+ * @brief Many independent games stored as structure of arrays
+ * @details Each board is a set of bitboards with one word per row, where bit
+ * X of word Y is the tile at (X, Y), so a whole row is updated at once. Board B
+ * uses the words `[B * h, (B + 1) * h)` of each bitboard.
+ *
+ * The bombs are placed on the first reveal of each game with the same function
+ * as `--seed`, so a game with seed S is the same board the game would generate
+ * for that seed and first reveal.
+ */
+typedef struct {
+    BatchOpts opts;
+
+    uint64_t* bombs;    /* Tiles with a bomb */
+    uint64_t* empty;    /* Tiles without bombs in their 3x3 area */
+    uint64_t* revealed; /* Revealed tiles */
+    uint64_t* flagged;  /* Flagged tiles that are not revealed */
+    uint64_t* region;   /* Opening being revealed, `h` words */
+
+    uint64_t* seeds;     /* Seed of the current game of each board */
+    uint16_t* safe;      /* Tiles without a bomb in each board */
+    uint16_t* safe_left; /* Tiles without a bomb that are still hidden */
+    uint8_t* started;    /* True if the bombs of the board were placed */
+
+    uint8_t* obs;   /* Observation of each tile, `w * h` per board */
+    float* rewards; /* Reward of the last action of each board */
+    uint8_t* dones; /* True if the last action of each board ended the game */
+} BatchEnv;
+
+/**
+ * @brief Allocates the boards and starts a game in each of them
+ * @param[in] opts Board options, `w` can't be more than BATCH_MAX_W
+ * @return New environment, or NULL on error
+ */
+BatchEnv* batch_create(const BatchOpts* opts);
+
+/**
+ * @brief Frees an environment returned by batch_create()
+ */
+void batch_destroy(BatchEnv* env);
+
+/**
+ * @brief Starts a new game in a board, with all its tiles hidden
+ * @param[inout] env Environment
+ * @param[in] board Index of the board
+ */
+void batch_reset(BatchEnv* env, uint32_t board);
+
+/**
+ * @brief Applies an action to each board
+ * @details Only the tiles that changed are written to `env->obs`. The reward of
+ * each board is the number of tiles it revealed divided by its number of safe
+ * tiles, so winning a game adds up to 1, and -1 if it revealed a bomb. A game
+ * is won when all the safe tiles are revealed, flags don't matter. Finished
+ * games are reset, so `env->obs` already shows the next one and `env->dones`
+ * tells which boards were reset.
+ * @param[inout] env Environment
+ * @param[in] actions Action of each board. Positions outside the board or
+ * revealed tiles are ignored.
+ */
+void batch_step(BatchEnv* env, const ShmAction* actions);
+
+/**
+ * @brief Measures the steps per second of batch_step() using all the cores
+ * @details Each thread steps its own environment with random actions on hidden
+ * tiles, and the totals are written to `out`.
+ * @param[in] opts Options of the environment of each thread
+ * @param[in] steps Number of calls to batch_step() in each thread
+ * @param[out] out File where the results will be written
+ * @return False on error
+ */
+bool batch_bench(const BatchOpts* opts, uint64_t steps, FILE* out);
+
+#endif /* _BATCH_H */
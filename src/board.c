@@ -0,0 +1,195 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "rng.h"
+#include "board.h"
+
+/**
+ * @brief Appends a tile to the list of the opening being labeled
+ * @param[inout] openings Openings of the board
+ * @param[in] idx Index of the tile
+ * @return False if there was not enough memory
+ */
+static bool openings_push(Openings* openings, uint32_t idx) {
+    if (openings->tiles_num >= openings->tiles_cap) {
+        const size_t new_cap = openings->tiles_cap * 2;
+        uint32_t* new_tiles =
+          realloc(openings->tiles, new_cap * sizeof(uint32_t));
+        if (new_tiles == NULL)
+            return false;
+
+        openings->tiles     = new_tiles;
+        openings->tiles_cap = new_cap;
+    }
+
+    openings->tiles[openings->tiles_num++] = idx;
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+
+bool openings_alloc(Openings* dst, int w, int h) {
+    const size_t sz = (size_t)w * h;
+
+    *dst = (Openings){
+        .counts    = malloc(sz),
+        .label     = malloc(sz * sizeof(uint32_t)),
+        .start     = malloc((sz + 1) * sizeof(uint32_t)),
+        .stack     = malloc(sz * sizeof(uint32_t)),
+        .tiles_cap = sz,
+        .tiles     = malloc(sz * sizeof(uint32_t)),
+    };
+
+    if (dst->counts == NULL || dst->label == NULL || dst->start == NULL ||
+        dst->stack == NULL || dst->tiles == NULL) {
+        openings_free(dst);
+        return false;
+    }
+
+    return true;
+}
+
+void openings_free(Openings* openings) {
+    free(openings->counts);
+    free(openings->label);
+    free(openings->start);
+    free(openings->stack);
+    free(openings->tiles);
+    *openings = (Openings){ 0 };
+}
+
+void board_stateless_bombs(uint8_t* counts, int w, int h, int start_x,
+                           int start_y, int bomb_percent, uint64_t seed) {
+    memset(counts, 0, (size_t)w * h);
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (in_safe_zone(x, y, start_x, start_y))
+                continue;
+
+            if (stateless_bomb(seed, x, y, bomb_percent))
+                counts[y * w + x] = COUNT_BOMB;
+        }
+    }
+}
+
+void board_random_bombs(uint8_t* counts, int w, int h, int start_x,
+                        int start_y, int bomb_percent, uint64_t ctr) {
+    memset(counts, 0, (size_t)w * h);
+
+    int total_bombs = h * w * bomb_percent / 100;
+
+    /* Actual tiles available for bombs (keep in mind the empty zone around the
+     * first reveal) */
+    const int max_bombs = w * h - BOMB_MARGIN * 4;
+    if (total_bombs > max_bombs)
+        total_bombs = max_bombs;
+
+    for (int bombs = 0; bombs < total_bombs; bombs++) {
+        const int bomb_y = splitmix64(ctr++) % h;
+        const int bomb_x = splitmix64(ctr++) % w;
+
+        /* Leave an empty zone around the first reveal */
+        if (in_safe_zone(bomb_x, bomb_y, start_x, start_y)) {
+            bombs--;
+            continue;
+        }
+
+        counts[bomb_y * w + bomb_x] = COUNT_BOMB;
+    }
+}
+
+bool board_openings(Openings* openings, int w, int h) {
+    const int sz    = w * h;
+    uint8_t* counts = openings->counts;
+
+    openings->bombs = 0;
+
+    /* Add each bomb to the count of its neighbors */
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (counts[y * w + x] != COUNT_BOMB)
+                continue;
+
+            openings->bombs++;
+            for (int ny = y - 1; ny <= y + 1; ny++)
+                for (int nx = x - 1; nx <= x + 1; nx++)
+                    if (ny >= 0 && ny < h && nx >= 0 && nx < w &&
+                        counts[ny * w + nx] != COUNT_BOMB)
+                        counts[ny * w + nx]++;
+        }
+    }
+
+    for (int i = 0; i < sz; i++)
+        openings->label[i] = NO_OPENING;
+
+    openings->num       = 0;
+    openings->tiles_num = 0;
+
+    for (int i = 0; i < sz; i++) {
+        if (counts[i] != 0 || openings->label[i] != NO_OPENING)
+            continue;
+
+        /* New opening, flood fill it. Numbers in the border also get the
+         * label, but only to avoid adding them twice to the same opening. */
+        const uint32_t id   = openings->num++;
+        openings->start[id] = openings->tiles_num;
+        openings->label[i]  = id;
+
+        size_t stack_pos             = 0;
+        openings->stack[stack_pos++] = i;
+
+        while (stack_pos > 0) {
+            const uint32_t cur = openings->stack[--stack_pos];
+            const int cur_y    = cur / w;
+            const int cur_x    = cur % w;
+
+            if (!openings_push(openings, cur))
+                goto alloc_error;
+
+            for (int ny = cur_y - 1; ny <= cur_y + 1; ny++) {
+                for (int nx = cur_x - 1; nx <= cur_x + 1; nx++) {
+                    if (ny < 0 || ny >= h || nx < 0 || nx >= w)
+                        continue;
+
+                    const uint32_t n = ny * w + nx;
+                    if (openings->label[n] == id)
+                        continue;
+
+                    openings->label[n] = id;
+
+                    /* Empty tiles are part of the opening, numbers are only
+                     * revealed. There can't be bombs next to an empty tile. */
+                    if (counts[n] == 0)
+                        openings->stack[stack_pos++] = n;
+                    else if (!openings_push(openings, n))
+                        goto alloc_error;
+                }
+            }
+        }
+    }
+
+    openings->start[openings->num] = openings->tiles_num;
+
+    /* Numbers that are not next to any opening need their own click */
+    openings->bbbv = openings->num;
+    for (int i = 0; i < sz; i++)
+        if (openings->label[i] == NO_OPENING && counts[i] != COUNT_BOMB)
+            openings->bbbv++;
+
+    return true;
+
+alloc_error:
+    /* Without the openings, empty tiles will only reveal themselves */
+    for (int i = 0; i < sz; i++)
+        openings->label[i] = NO_OPENING;
+
+    openings->num  = 0;
+    openings->bbbv = 0;
+    return false;
+}
@@ -0,0 +1,89 @@
+#ifndef _BOARD_H
+#define _BOARD_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @def COUNT_BOMB
+ * @brief Value used in the count plane for tiles with a bomb
+ */
+#define COUNT_BOMB 9
+
+/**
+ * @struct Openings
+ * @brief Count plane of a board, and the openings computed from it
+ * @details The tiles revealed by opening N (its empty tiles and its numbered
+ * border) are `tiles[start[N]]` to `tiles[start[N + 1] - 1]`.
+ */
+typedef struct {
+    uint8_t* counts;  /* Adjacent bombs of each tile, or COUNT_BOMB */
+    uint32_t* label;  /* Opening of each empty tile, or NO_OPENING */
+    uint32_t* start;  /* Index in `tiles` of each opening, plus the end */
+    uint32_t* tiles;  /* Tiles revealed by each opening */
+    size_t tiles_num; /* Number of used items in `tiles` */
+    size_t tiles_cap; /* Number of allocated items in `tiles` */
+    uint32_t* stack;  /* Used for labeling the openings */
+    uint32_t num;     /* Number of openings */
+    uint32_t bombs;   /* Number of bombs */
+    uint32_t bbbv;    /* Minimum number of clicks needed to clear the board */
+} Openings;
+
+/**
+ * @brief Allocates the buffers of the openings of a board
+ * @details There can't be more openings than tiles, the list of tiles grows if
+ * needed.
+ * @param[out] dst Openings to allocate
+ * @param[in] w, h Size of the board
+ * @return False if there was not enough memory
+ */
+bool openings_alloc(Openings* dst, int w, int h);
+
+/**
+ * @brief Frees the buffers allocated by openings_alloc()
+ */
+void openings_free(Openings* openings);
+
+/**
+ * @brief Fills a count plane with the bombs of a stateless board
+ * @details Each tile has a bomb depending on the seed (see stateless_bomb()),
+ * except in the safe zone around the first reveal.
+ * @param[out] counts Count plane, COUNT_BOMB for bombs and 0 for the rest
+ * @param[in] w, h Size of the board
+ * @param[in] start_x, start_y Position of the first reveal
+ * @param[in] bomb_percent Percentage of bombs, from 0 to 100
+ * @param[in] seed Seed of the board
+ */
+void board_stateless_bombs(uint8_t* counts, int w, int h, int start_x,
+                           int start_y, int bomb_percent, uint64_t seed);
+
+/**
+ * @brief Fills a count plane with bombs at random positions
+ * @details The positions are taken from the splitmix64() stream that starts
+ * at `ctr`. Positions in the safe zone around the first reveal are skipped,
+ * and repeated positions are only counted once.
+ * @param[out] counts Count plane, COUNT_BOMB for bombs and 0 for the rest
+ * @param[in] w, h Size of the board
+ * @param[in] start_x, start_y Position of the first reveal
+ * @param[in] bomb_percent Percentage of bombs, from 0 to 100
+ * @param[in] ctr First counter of the random stream
+ */
+void board_random_bombs(uint8_t* counts, int w, int h, int start_x,
+                        int start_y, int bomb_percent, uint64_t ctr);
+
+/**
+ * @brief Computes the numbers, the openings and the 3BV of a board
+ * @details Each opening is a connected region of empty tiles, and it's labeled
+ * once with a flood fill, storing the list of tiles it reveals. Numbers that
+ * are not next to any opening need their own click, so the 3BV is the number
+ * of openings plus the number of those.
+ * @param[inout] openings Openings of the board. Its count plane should only
+ * contain COUNT_BOMB and 0, and the numbers are added to it.
+ * @param[in] w, h Size of the board
+ * @return False if there was not enough memory. The numbers are still valid,
+ * but there are no openings and the 3BV is 0.
+ */
+bool board_openings(Openings* openings, int w, int h);
+
+#endif /* _BOARD_H */
@@ -89,6 +89,12 @@ enum color_ids {
  */
 #define BOMB_MARGIN 3
 
+/**
+ * @def STATUS_INTERVAL
+ * @brief Milliseconds between each update of the status line while playing
+ */
+#define STATUS_INTERVAL 1000
+
 #define DEFAULT_DIFFICULTY 30 /**< @brief 1-100% */
 #define MIN_BOMBS          5  /**< @brief Minimum ammount of bombs */
 #define MAX_BOMBS          60 /**< @brief Maximum ammount of bombs */
@@ -113,6 +119,68 @@ enum playing_flags {
     PLAYING_CLEAR = 0x2, /* Just initialized the empty grid. Fill with bombs */
 };
 
+/**
+ * @enum game_modes
+ * @brief For Game.mode
+ * @details Modifiers applied to every tile of the current game when reading it,
+ * without having to write the whole grid.
+ */
+enum game_modes {
+    MODE_NONE      = 0x0, /* Tiles are read as they are stored */
+    MODE_REVEALED  = 0x1, /* Every tile is read as FLAG_CLEARED */
+    MODE_STATELESS = 0x2, /* Bombs are computed from Game.seed, not stored */
+};
+
+/**
+ * @def BENCH_STEPS
+ * @brief Number of times each board is stepped by `--bench`
+ */
+#define BENCH_STEPS 1000
+
+/**
+ * @def BENCH_MAX_BOARDS
+ * @brief Maximum number of boards of each thread of `--bench`
+ */
+#define BENCH_MAX_BOARDS 65536
+
+/**
+ * @def FEED_RUN_MAX
+ * @brief Maximum number of tiles in each reveal event of the `--feed` output
+ */
+#define FEED_RUN_MAX 256
+
+/**
+ * @def SHM_SPIN_TIME
+ * @brief Microseconds to keep checking the `--shm` queue without sleeping
+ * after the last action
+ */
+#define SHM_SPIN_TIME 2000
+
+/**
+ * @def SHM_BATCH
+ * @brief Maximum number of queued `--shm` actions processed before checking
+ * the keyboard again
+ */
+#define SHM_BATCH 256
+
+/**
+ * @def SHM_SLEEP_MAX
+ * @brief Maximum milliseconds between checks of an idle `--shm` queue
+ */
+#define SHM_SLEEP_MAX 64
+
+/**
+ * @def FRAME_INTERVAL
+ * @brief Minimum milliseconds between the frames drawn for `--shm` actions
+ */
+#define FRAME_INTERVAL 16
+
+/**
+ * @def NO_OPENING
+ * @brief Label of the tiles that are not part of an opening
+ */
+#define NO_OPENING UINT32_MAX
+
 /**
  * @enum tile_chars
  * @brief Characters for the tiles
@@ -124,10 +192,31 @@ enum tile_chars {
     CH_FLAG = 'F', /* Flagged hidden tile */
 };
 
+/**
+ * @enum move_types
+ * @brief For Move.type
+ */
+enum move_types {
+    MOVE_REVEAL = 0, /* Tiles got the FLAG_CLEARED bit set */
+    MOVE_FLAG   = 1, /* Tiles got the FLAG_FLAGGED bit toggled */
+};
+
 /**
  * @def KEY_CTRLC
  * @brief Needed for getch()
  */
 #define KEY_CTRLC 3
 
+/**
+ * @def KEY_CTRLR
+ * @brief Used for redoing moves with getch()
+ */
+#define KEY_CTRLR 18
+
+/**
+ * @def KEY_SHM
+ * @brief Returned by wait_key() when there are actions in the `--shm` queue
+ */
+#define KEY_SHM (KEY_MAX + 1)
+
 #endif /* _DEFINES_H */
@@ -0,0 +1,197 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>  /* open, fcntl */
+#include <signal.h> /* signal */
+#include <unistd.h> /* write, close */
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "feed.h"
+
+/**
+ * @def FEED_BUF_SZ
+ * @brief Size of the ring buffer, the events that don't fit are dropped
+ */
+#define FEED_BUF_SZ (64 * 1024)
+
+/**
+ * @def FEED_LINE_MAX
+ * @brief Maximum size of an event formatted with feed_printf()
+ */
+#define FEED_LINE_MAX 512
+
+/**
+ * @var feed_fd
+ * @brief Output of the feed, or -1 if closed
+ */
+static int feed_fd = -1;
+
+/**
+ * @var ring
+ * @brief Ring buffer with the events that have not been written yet
+ * @details The pending bytes start at `ring_head` and there are `ring_len` of
+ * them, wrapping around the end of the buffer.
+ */
+static char ring[FEED_BUF_SZ];
+static size_t ring_head = 0;
+static size_t ring_len  = 0;
+
+/**
+ * @var dropped
+ * @brief Number of events dropped since the last one that fit
+ */
+static unsigned long dropped = 0;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Copies bytes to the end of the ring buffer
+ * @details Assumes there is enough space.
+ */
+static void ring_push(const char* data, size_t sz) {
+    size_t tail = (ring_head + ring_len) % FEED_BUF_SZ;
+
+    const size_t first = (sz < FEED_BUF_SZ - tail) ? sz : FEED_BUF_SZ - tail;
+    memcpy(&ring[tail], data, first);
+    memcpy(ring, data + first, sz - first);
+
+    ring_len += sz;
+}
+
+bool feed_open(const char* path) {
+    struct stat st;
+    const bool exists = stat(path, &st) == 0;
+
+    if (exists && S_ISSOCK(st.st_mode)) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+
+        strcpy(addr.sun_path, path);
+
+        feed_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (feed_fd < 0)
+            return false;
+
+        if (connect(feed_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            fcntl(feed_fd, F_SETFL, O_NONBLOCK) < 0) {
+            close(feed_fd);
+            feed_fd = -1;
+            return false;
+        }
+    } else {
+        /* With O_RDWR, opening a FIFO doesn't fail if there is no reader */
+        const bool fifo = exists && S_ISFIFO(st.st_mode);
+        const int flags = (fifo ? O_RDWR : O_WRONLY | O_TRUNC) | O_CREAT |
+                          O_NONBLOCK | O_CLOEXEC;
+
+        feed_fd = open(path, flags, 0644);
+        if (feed_fd < 0)
+            return false;
+    }
+
+    /* A closed reader should only close the feed, not the game */
+    signal(SIGPIPE, SIG_IGN);
+
+    ring_head = 0;
+    ring_len  = 0;
+    dropped   = 0;
+    return true;
+}
+
+void feed_close(void) {
+    if (feed_fd < 0)
+        return;
+
+    feed_flush();
+    close(feed_fd);
+    feed_fd = -1;
+}
+
+bool feed_enabled(void) {
+    return feed_fd >= 0;
+}
+
+void feed_event(const char* data, size_t sz) {
+    if (feed_fd < 0)
+        return;
+
+    /* Let the consumer know that it missed some events */
+    if (dropped > 0) {
+        char drop_event[32];
+        const int drop_sz = snprintf(drop_event, sizeof(drop_event), "d %lu\n",
+                                     dropped);
+
+        if (ring_len + drop_sz + sz > FEED_BUF_SZ) {
+            dropped++;
+            return;
+        }
+
+        ring_push(drop_event, drop_sz);
+        dropped = 0;
+    } else if (ring_len + sz > FEED_BUF_SZ) {
+        dropped++;
+        return;
+    }
+
+    ring_push(data, sz);
+}
+
+void feed_printf(const char* fmt, ...) {
+    if (feed_fd < 0)
+        return;
+
+    char line[FEED_LINE_MAX];
+
+    va_list va;
+    va_start(va, fmt);
+    int sz = vsnprintf(line, sizeof(line), fmt, va);
+    va_end(va);
+
+    if (sz < 0)
+        return;
+
+    if ((size_t)sz >= sizeof(line))
+        sz = sizeof(line) - 1;
+
+    feed_event(line, sz);
+}
+
+void feed_flush(void) {
+    while (feed_fd >= 0 && ring_len > 0) {
+        /* Contiguous bytes until the end of the buffer */
+        const size_t chunk =
+          (ring_len < FEED_BUF_SZ - ring_head) ? ring_len
+                                               : FEED_BUF_SZ - ring_head;
+
+        const ssize_t written = write(feed_fd, &ring[ring_head], chunk);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            /* The consumer is gone, stop feeding */
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                close(feed_fd);
+                feed_fd = -1;
+            }
+
+            return;
+        }
+
+        ring_head = (ring_head + written) % FEED_BUF_SZ;
+        ring_len -= written;
+    }
+}
+
+int feed_poll_fd(void) {
+    return (ring_len > 0) ? feed_fd : -1;
+}
@@ -0,0 +1,53 @@
+#ifndef _FEED_H
+#define _FEED_H 1
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Opens the output of the state-delta feed
+ * @details If `path` is a Unix socket, it connects to it. Otherwise, it opens
+ * it for writing (creating a regular file if needed), so it can also be a FIFO
+ * without a reader yet. All writes are non-blocking.
+ * @param[in] path Path of the file, FIFO or socket
+ * @return False on error, with errno set
+ */
+bool feed_open(const char* path);
+
+/**
+ * @brief Flushes as much as possible without blocking, and closes the feed
+ */
+void feed_close(void);
+
+/**
+ * @brief Returns true if the feed is open
+ */
+bool feed_enabled(void);
+
+/**
+ * @brief Queues a whole event in the ring buffer
+ * @details If the event doesn't fit, it's dropped, and a `d N` event with the
+ * number of dropped events will be queued before the next one that fits.
+ * @param[in] data Bytes of the event, usually a line of text
+ * @param[in] sz Number of bytes
+ */
+void feed_event(const char* data, size_t sz);
+
+/**
+ * @brief Formats an event with printf syntax and queues it with feed_event()
+ */
+void feed_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Writes the queued events without blocking
+ * @details Whatever can't be written now stays in the ring buffer.
+ */
+void feed_flush(void);
+
+/**
+ * @brief Returns the file descriptor that should be polled for POLLOUT
+ * @return File descriptor, or -1 if there is nothing to write
+ */
+int feed_poll_fd(void);
+
+#endif /* _FEED_H */
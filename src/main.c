@@ -5,26 +5,42 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>  /* time */
-#include <ctype.h> /* tolower */
+#include <time.h>   /* time, clock_gettime */
+#include <ctype.h>  /* tolower */
+#include <errno.h>  /* errno */
+#include <unistd.h> /* write, read, pread */
+#include <fcntl.h>  /* open */
+#include <poll.h>   /* poll */
+#include <sched.h>  /* sched_yield */
+#include <sys/timerfd.h>
 #include <ncurses.h>
 
 #include "defines.h"
+#include "rng.h"
+#include "analyze.h"
+#include "batch.h"
+#include "board.h"
+#include "feed.h"
+#include "shm.h"
+#include "solver.h"
 
 #define DIFFIC2BOMBPERCENT(d) ((MAX_BOMBS - MIN_BOMBS) * d / 100 + MIN_BOMBS)
-#define REVEAL_TILE(P)        ms.grid[P.y * ms.w + P.x].flags |= FLAG_CLEARED
-#define HAS_FLAG(P, F)        (ms.grid[P.y * ms.w + P.x].flags & F)
-#define HAS_CHAR(P, C)        (ms.grid[P.y * ms.w + P.x].c == C)
+#define REVEAL_TILE(P)        reveal_tile(P.y * ms.w + P.x)
+#define HAS_FLAG(P, F)        (tile_flags(P.y * ms.w + P.x) & F)
+#define HAS_CHAR(P, C)        (tile_char(P.y * ms.w + P.x) == C)
 
 /**
  * @struct Tile
  * @brief Tile of the minesweeper
  * @description The char indicates its contents and the flags special
- * information (for example if the user flagged the tile, revealed it...)
+ * information (for example if the user flagged the tile, revealed it...). If
+ * the epoch doesn't match Game.epoch, the tile belongs to an old game and it
+ * should be read as an empty hidden tile.
  */
 typedef struct {
-    char c;        /* Char in that tile, actual item */
-    uint8_t flags; /* Tile status (revealed, flagged, etc) */
+    char c;         /* Char in that tile, actual item */
+    uint8_t flags;  /* Tile status (revealed, flagged, etc) */
+    uint16_t epoch; /* Game.epoch of the last write to this tile */
 } Tile;
 
 /**
@@ -36,6 +52,16 @@ typedef struct {
     Tile* grid;         /* Pointer to the minesweeper grid */
     uint8_t playing;    /* The user revealed the first tile */
     uint8_t difficulty; /* Percentage of bombs to fill in the grid */
+    uint8_t mode;       /* Modifiers for all tiles (see game_modes) */
+    uint16_t epoch;     /* Current game, tiles from other epochs are stale */
+    uint64_t seed;      /* Seed of the bombs, if MODE_STATELESS */
+    int32_t start_x;    /* First revealed tile, if MODE_STATELESS */
+    int32_t start_y;    /* First revealed tile, if MODE_STATELESS */
+    uint8_t bomb_pct;   /* Percentage of bombs, if MODE_STATELESS */
+    uint32_t bombs;     /* Number of bombs in the grid */
+    uint32_t flagged;   /* Number of flagged tiles */
+    uint64_t t_start;   /* Monotonic time when the game started, or 0 */
+    uint64_t t_end;     /* Monotonic time when the game ended, or 0 */
 } Game;
 
 /**
@@ -46,6 +72,72 @@ typedef struct {
     int32_t x, y;
 } vec2_t;
 
+/**
+ * @struct Run
+ * @brief Range of consecutive tile indices changed by a single move
+ */
+typedef struct {
+    uint32_t start; /* Index of the first tile in ms.grid */
+    uint32_t len;   /* Number of tiles */
+} Run;
+
+/**
+ * @struct Move
+ * @brief Entry of the undo/redo journal
+ */
+typedef struct {
+    uint8_t type;           /* What changed in the tiles (see move_types) */
+    uint8_t playing_before; /* Value of ms.playing before the move */
+    uint8_t playing_after;  /* Value of ms.playing after the move */
+    size_t first_run;       /* Index of the first run in Journal.runs */
+    size_t runs_num;        /* Number of runs in Journal.runs */
+} Move;
+
+/**
+ * @struct Journal
+ * @brief Undo/redo stack with the tiles changed by each move
+ * @details Moves in `[0, cur)` can be undone, and moves in `[cur, moves_num)`
+ * can be redone. The indices changed by the move being recorded are stored in
+ * `pending` and compressed into runs once the move is committed, so each move
+ * only uses memory proportional to the tiles it changed.
+ */
+typedef struct {
+    Move* moves;         /* Array of moves */
+    size_t moves_num;    /* Number of moves, including the undone ones */
+    size_t moves_cap;    /* Allocated moves */
+    size_t cur;          /* Number of moves that can be undone */
+    Run* runs;           /* Runs of all the moves */
+    size_t runs_num;     /* Number of runs used by the moves */
+    size_t runs_cap;     /* Allocated runs */
+    uint32_t* pending;   /* Indices changed by the current move */
+    size_t pending_num;  /* Number of indices in `pending` */
+    uint8_t cur_type;    /* Type of the current move */
+    uint8_t cur_playing; /* Value of ms.playing before the current move */
+} Journal;
+
+/**
+ * @struct Frame
+ * @brief Buffer used by the ANSI backend for building a whole frame
+ * @details Rows that didn't change since the last frame are not included in
+ * the buffer.
+ */
+typedef struct {
+    char* data;           /* Escape sequences and chars of the frame */
+    size_t len;           /* Bytes used in `data` */
+    size_t cap;           /* Bytes allocated for `data` */
+    uint64_t* row_hashes; /* Hash of each screen row in the last frame */
+} Frame;
+
+/**
+ * @struct FrameStats
+ * @brief Accumulated rendering statistics, printed with `--stats`
+ */
+typedef struct {
+    uint64_t frames; /* Number of frames drawn */
+    uint64_t nsecs;  /* Total time spent drawing frames */
+    uint64_t bytes;  /* Total bytes written to the terminal by the frames */
+} FrameStats;
+
 /*----------------------------------------------------------------------------*/
 
 /**
@@ -61,20 +153,598 @@ static Game ms;
 static bool use_color = false;
 
 /**
- * @var queue
- * @brief Global vec2_t queue
- * @details Used by reveal_tiles() to avoid recursion. Allocated and freed from
- * main()
+ * @var use_ansi
+ * @brief If true, the grid is drawn with the ANSI backend instead of ncurses
+ */
+static bool use_ansi = false;
+
+/**
+ * @var use_seed
+ * @brief If true, bombs are computed from `seed` instead of stored in the grid
+ */
+static bool use_seed = false;
+
+/**
+ * @var seed
+ * @brief Seed used by the next game, if `use_seed` is true
+ */
+static uint64_t seed = 0;
+
+/**
+ * @var analyze_count
+ * @brief If not zero, analyze this number of boards instead of playing
  */
-static vec2_t* queue = NULL;
+static uint64_t analyze_count = 0;
 
 /**
- * @var queue_pos
- * @brief Top of the queue
- * @details Index in the queue that will be used for the next pushed item, not
- * the index of the last item.
+ * @var bench_boards
+ * @brief If not zero, benchmark the batch environment with this number of
+ * boards per thread instead of playing
  */
-static int queue_pos = 0;
+static uint32_t bench_boards = 0;
+
+/**
+ * @var feed_path
+ * @brief If not NULL, path where the state-delta feed will be written
+ */
+static const char* feed_path = NULL;
+
+/**
+ * @var shm_name
+ * @brief If not NULL, name of the shared memory segment for external bots
+ */
+static const char* shm_name = NULL;
+
+/**
+ * @var shm_board
+ * @brief Shared memory segment created with `--shm`, or NULL
+ */
+static ShmBoard* shm_board = NULL;
+
+/**
+ * @var shm_last_action
+ * @brief Monotonic time when wait_key() last found actions in `shm_board`
+ */
+static uint64_t shm_last_action = 0;
+
+/**
+ * @var shm_sleep
+ * @brief Milliseconds that wait_key() will sleep next time `shm_board` is idle
+ */
+static int shm_sleep = 1;
+
+/**
+ * @var shm_batch
+ * @brief Actions returned by wait_key() since it last called getch()
+ */
+static int shm_batch = 0;
+
+/**
+ * @var show_stats
+ * @brief If true, the frame statistics are printed when exiting
+ */
+static bool show_stats = false;
+
+/**
+ * @var io_fd
+ * @brief Open `/proc/self/io` for counting the bytes of each frame, or -1
+ * @details Only opened with `show_stats`. The counter includes every write(),
+ * so it measures the output of ncurses and the ANSI backend the same way.
+ */
+static int io_fd = -1;
+
+/**
+ * @var color_fg
+ * @brief Foreground of each color id, for ncurses and the ANSI backend
+ */
+static const short color_fg[] = {
+    [COL_NORM] = COLOR_WHITE,   [COL_1] = COLOR_CYAN,
+    [COL_2]    = COLOR_BLUE,    [COL_3] = COLOR_GREEN,
+    [COL_4]    = COLOR_YELLOW,  [COL_5] = COLOR_MAGENTA,
+    [COL_6]    = COLOR_MAGENTA, [COL_7] = COLOR_MAGENTA,
+    [COL_8]    = COLOR_MAGENTA, [COL_9] = COLOR_MAGENTA,
+    [COL_FLAG] = COLOR_RED,     [COL_BOMB] = COLOR_RED,
+    [COL_UNK]  = COLOR_WHITE,
+};
+
+/**
+ * @var ansi_esc
+ * @brief Cached escape sequences for each color id, without and with bold
+ * @details Filled by ansi_init()
+ */
+static char ansi_esc[2][COL_UNK + 1][24];
+
+/**
+ * @var timer_fd
+ * @brief Timer used for updating the status line, or -1
+ */
+static int timer_fd = -1;
+
+/**
+ * @var timer_armed
+ * @brief True if `timer_fd` is currently running
+ */
+static bool timer_armed = false;
+
+/**
+ * @var frame
+ * @brief Frame buffer of the ANSI backend
+ */
+static Frame frame;
+
+/**
+ * @var frame_stats
+ * @brief Global rendering statistics
+ */
+static FrameStats frame_stats;
+
+/**
+ * @var frame_last
+ * @brief Monotonic time when the last frame was drawn
+ */
+static uint64_t frame_last = 0;
+
+/**
+ * @var frame_pending
+ * @brief True if a frame was skipped, and it should be drawn once it's due
+ */
+static bool frame_pending = false;
+
+/**
+ * @var openings
+ * @brief Precomputed openings of the current grid
+ * @details Filled by generate_grid(), used by reveal_tiles(). The buffers are
+ * allocated and freed from main().
+ */
+static Openings openings;
+
+/**
+ * @var journal
+ * @brief Global undo/redo journal
+ * @details The `pending` buffer is allocated and freed from main()
+ */
+static Journal journal;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Returns the char of a tile in a game with MODE_STATELESS
+ * @details The bomb is a pure function of the seed and the position, with the
+ * BOMB_MARGIN safe zone around the first revealed tile.
+ * @param[in] idx Index of the tile in ms.grid
+ * @return CH_BOMB or CH_BACK
+ */
+static inline char stateless_char(int idx) {
+    const int32_t x = idx % ms.w;
+    const int32_t y = idx / ms.w;
+
+    /* Leave an empty zone around the first revealed tile */
+    if (in_safe_zone(x, y, ms.start_x, ms.start_y))
+        return CH_BACK;
+
+    return stateless_bomb(ms.seed, x, y, ms.bomb_pct) ? CH_BOMB : CH_BACK;
+}
+
+/**
+ * @brief Returns the char of the tile at the specified index
+ * @param[in] idx Index of the tile in ms.grid
+ * @return Char of the tile, or CH_BACK if the tile is from an old game
+ */
+static inline char tile_char(int idx) {
+    if (ms.mode & MODE_STATELESS)
+        return stateless_char(idx);
+
+    const Tile* tile = &ms.grid[idx];
+    return (tile->epoch == ms.epoch) ? tile->c : CH_BACK;
+}
+
+/**
+ * @brief Returns the flags of the tile at the specified index
+ * @details Stale tiles are read as FLAG_NONE, and ms.mode is applied on top.
+ * @param[in] idx Index of the tile in ms.grid
+ * @return Flags of the tile (see tile_flags enum)
+ */
+static inline uint8_t tile_flags(int idx) {
+    const Tile* tile = &ms.grid[idx];
+    uint8_t flags    = (tile->epoch == ms.epoch) ? tile->flags : FLAG_NONE;
+
+    if (ms.mode & MODE_REVEALED)
+        flags |= FLAG_CLEARED;
+
+    return flags;
+}
+
+/**
+ * @brief Returns a pointer to the tile at the specified index for writing
+ * @details If the tile is from an old game, it gets reset and stamped with the
+ * current epoch first.
+ * @param[in] idx Index of the tile in ms.grid
+ * @return Pointer to the tile in ms.grid
+ */
+static inline Tile* tile_get(int idx) {
+    Tile* tile = &ms.grid[idx];
+
+    if (tile->epoch != ms.epoch) {
+        tile->c     = CH_BACK;
+        tile->flags = FLAG_NONE;
+        tile->epoch = ms.epoch;
+    }
+
+    return tile;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Sends a run of revealed tiles to the feed, with their contents
+ * @details Each tile is sent as its number of adjacent bombs, or '@' if it's a
+ * bomb. Long runs are split in several events.
+ * @param[in] start Index of the first tile in ms.grid
+ * @param[in] len Number of tiles
+ */
+static void feed_reveal_run(uint32_t start, uint32_t len) {
+    char line[FEED_RUN_MAX + 32];
+
+    while (len > 0) {
+        const uint32_t chunk = (len < FEED_RUN_MAX) ? len : FEED_RUN_MAX;
+
+        int sz = sprintf(line, "r %u %u ", start, chunk);
+        for (uint32_t idx = start; idx < start + chunk; idx++) {
+            if (tile_char(idx) == CH_BOMB)
+                line[sz++] = '@';
+            else
+                line[sz++] = '0' + openings.counts[idx];
+        }
+        line[sz++] = '\n';
+
+        feed_event(line, sz);
+        start += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * @brief Sends the changes of a move that was just applied or reverted to the
+ * feed
+ * @details Also sends an event if the move ended the game (`l` or `w`) or if
+ * reverting it resumed the game (`p`).
+ * @param[in] move Move from the journal
+ * @param[in] undo True if the move was reverted
+ */
+static void feed_move(const Move* move, bool undo) {
+    if (!feed_enabled())
+        return;
+
+    for (size_t i = 0; i < move->runs_num; i++) {
+        const Run* run = &journal.runs[move->first_run + i];
+
+        if (move->type == MOVE_FLAG)
+            for (uint32_t idx = run->start; idx < run->start + run->len; idx++)
+                feed_printf("f %u %d\n", idx,
+                            (tile_flags(idx) & FLAG_FLAGGED) != 0);
+        else if (undo)
+            feed_printf("h %u %u\n", run->start, run->len);
+        else
+            feed_reveal_run(run->start, run->len);
+    }
+
+    const uint8_t from = undo ? move->playing_after : move->playing_before;
+    const uint8_t to   = undo ? move->playing_before : move->playing_after;
+
+    /* Revealing can only end the game by losing, flagging by winning */
+    if (from != PLAYING_FALSE && to == PLAYING_FALSE)
+        feed_printf(move->type == MOVE_FLAG ? "w\n" : "l\n");
+    else if (from == PLAYING_FALSE && to != PLAYING_FALSE)
+        feed_printf("p\n");
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Returns the observation of a tile for the `--shm` segment
+ * @param[in] idx Index of the tile in ms.grid
+ * @return Value of the tile (see obs_values enum)
+ */
+static inline uint8_t tile_obs(int idx) {
+    const uint8_t flags = tile_flags(idx);
+
+    if (flags & FLAG_CLEARED)
+        return (tile_char(idx) == CH_BOMB) ? OBS_BOMB : openings.counts[idx];
+
+    return (flags & FLAG_FLAGGED) ? OBS_FLAG : OBS_HIDDEN;
+}
+
+/**
+ * @brief Updates the header of the `--shm` segment from ms
+ * @details Should be called between shm_board_begin() and shm_board_end().
+ * The state of a finished game is set by the caller.
+ */
+static void shm_header(void) {
+    const bool started = ms.playing != PLAYING_CLEAR;
+
+    if (ms.playing == PLAYING_CLEAR)
+        shm_board->state = SHM_READY;
+    else if (ms.playing == PLAYING_TRUE)
+        shm_board->state = SHM_PLAYING;
+
+    shm_board->bombs   = started ? ms.bombs : 0;
+    shm_board->flagged = ms.flagged;
+    shm_board->bbbv    = started ? openings.bbbv : 0;
+}
+
+/**
+ * @brief Writes the tiles changed by a move that was just applied or reverted
+ * to the `--shm` segment
+ * @param[in] move Move from the journal
+ * @param[in] undo True if the move was reverted
+ */
+static void shm_move(const Move* move, bool undo) {
+    if (shm_board == NULL)
+        return;
+
+    shm_board_begin(shm_board);
+
+    for (size_t i = 0; i < move->runs_num; i++) {
+        const Run* run = &journal.runs[move->first_run + i];
+        for (uint32_t idx = run->start; idx < run->start + run->len; idx++)
+            shm_board->tiles[idx] = tile_obs(idx);
+    }
+
+    /* Same as in feed_move(), the type of the move tells how it ended */
+    const uint8_t to = undo ? move->playing_before : move->playing_after;
+    if (to == PLAYING_FALSE)
+        shm_board->state = (move->type == MOVE_FLAG) ? SHM_WON : SHM_LOST;
+
+    shm_header();
+    shm_board_end(shm_board);
+}
+
+/**
+ * @brief Writes the whole grid to the `--shm` segment
+ * @details Used when every tile changes at once, after starting a new game or
+ * revealing all tiles.
+ * @param[in] state State of the game (see shm_states enum)
+ */
+static void shm_refresh(uint32_t state) {
+    if (shm_board == NULL)
+        return;
+
+    shm_board_begin(shm_board);
+
+    if (state == SHM_READY) {
+        shm_board->game++;
+        memset(shm_board->tiles, OBS_HIDDEN, ms.w * ms.h);
+    } else {
+        for (int idx = 0; idx < ms.w * ms.h; idx++)
+            shm_board->tiles[idx] = tile_obs(idx);
+    }
+
+    shm_board->state = state;
+    shm_header();
+    shm_board_end(shm_board);
+}
+
+/**
+ * @brief Lets the external process know that an action was processed
+ */
+static void shm_done(void) {
+    shm_board_begin(shm_board);
+    shm_board->done++;
+    shm_board_end(shm_board);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Discards all the moves in the journal
+ * @details Doesn't free any memory, it will be reused by the next game.
+ */
+static inline void journal_clear(void) {
+    journal.moves_num   = 0;
+    journal.cur         = 0;
+    journal.runs_num    = 0;
+    journal.pending_num = 0;
+}
+
+/**
+ * @brief Starts recording a new move in the journal
+ * @param[in] type Type of the move (see move_types)
+ */
+static inline void journal_begin(uint8_t type) {
+    journal.pending_num = 0;
+    journal.cur_type    = type;
+    journal.cur_playing = ms.playing;
+}
+
+/**
+ * @brief Records a tile that was changed by the current move
+ * @details Each tile should only be recorded once per move.
+ * @param[in] idx Index of the tile in ms.grid
+ */
+static inline void journal_record(uint32_t idx) {
+    journal.pending[journal.pending_num++] = idx;
+}
+
+/**
+ * @brief Compare function for qsort(), used by journal_commit()
+ */
+static int cmp_idx(const void* a, const void* b) {
+    const uint32_t ia = *(const uint32_t*)a;
+    const uint32_t ib = *(const uint32_t*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+/**
+ * @brief Makes sure the journal can store one more move with `runs` runs
+ * @param[in] runs Maximum number of runs that will be added
+ * @return False if there was not enough memory
+ */
+static bool journal_reserve(size_t runs) {
+    if (journal.moves_num >= journal.moves_cap) {
+        const size_t new_cap = journal.moves_cap ? journal.moves_cap * 2 : 64;
+        Move* new_moves = realloc(journal.moves, new_cap * sizeof(Move));
+        if (new_moves == NULL)
+            return false;
+
+        journal.moves     = new_moves;
+        journal.moves_cap = new_cap;
+    }
+
+    if (journal.runs_num + runs > journal.runs_cap) {
+        size_t new_cap = journal.runs_cap ? journal.runs_cap * 2 : 256;
+        while (new_cap < journal.runs_num + runs)
+            new_cap *= 2;
+
+        Run* new_runs = realloc(journal.runs, new_cap * sizeof(Run));
+        if (new_runs == NULL)
+            return false;
+
+        journal.runs     = new_runs;
+        journal.runs_cap = new_cap;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stores the current move in the journal
+ * @details The recorded indices are sorted and compressed into runs of
+ * consecutive tiles. Moves that didn't change any tile are ignored. Otherwise,
+ * the moves that could be redone are discarded.
+ */
+static void journal_commit(void) {
+    if (journal.pending_num == 0)
+        return;
+
+    /* Discard the redo history */
+    journal.moves_num = journal.cur;
+    if (journal.cur > 0) {
+        const Move* last = &journal.moves[journal.cur - 1];
+        journal.runs_num = last->first_run + last->runs_num;
+    } else {
+        journal.runs_num = 0;
+    }
+
+    qsort(journal.pending, journal.pending_num, sizeof(uint32_t), cmp_idx);
+
+    /* A new run starts at every tile that doesn't follow the previous one */
+    size_t runs = 1;
+    for (size_t i = 1; i < journal.pending_num; i++)
+        if (journal.pending[i] != journal.pending[i - 1] + 1)
+            runs++;
+
+    if (!journal_reserve(runs)) {
+        journal_clear();
+        return;
+    }
+
+    Move* move = &journal.moves[journal.moves_num++];
+    *move = (Move){
+        .type           = journal.cur_type,
+        .playing_before = journal.cur_playing,
+        .playing_after  = ms.playing,
+        .first_run      = journal.runs_num,
+        .runs_num       = 0,
+    };
+
+    for (size_t i = 0; i < journal.pending_num; i++) {
+        const uint32_t idx = journal.pending[i];
+
+        /* Extend the last run of this move if the tile is next to it */
+        if (move->runs_num > 0) {
+            Run* last = &journal.runs[journal.runs_num - 1];
+            if (last->start + last->len == idx) {
+                last->len++;
+                continue;
+            }
+        }
+
+        journal.runs[journal.runs_num++] = (Run){ .start = idx, .len = 1 };
+        move->runs_num++;
+    }
+
+    journal.cur         = journal.moves_num;
+    journal.pending_num = 0;
+
+    feed_move(move, false);
+    shm_move(move, false);
+}
+
+/**
+ * @brief Applies or reverts a move from the journal on ms.grid
+ * @param[in] move Move to apply or revert
+ * @param[in] undo True for reverting the move, false for applying it again
+ */
+static void journal_apply(const Move* move, bool undo) {
+    for (size_t i = 0; i < move->runs_num; i++) {
+        const Run* run = &journal.runs[move->first_run + i];
+
+        for (uint32_t idx = run->start; idx < run->start + run->len; idx++) {
+            Tile* tile = tile_get(idx);
+
+            if (move->type == MOVE_FLAG) {
+                tile->flags ^= FLAG_FLAGGED;
+                ms.flagged += (tile->flags & FLAG_FLAGGED) ? 1 : -1;
+                continue;
+            }
+
+            if (undo)
+                tile->flags &= ~FLAG_CLEARED;
+            else
+                tile->flags |= FLAG_CLEARED;
+
+            /* Same as reveal_tile(), revealed flags are not counted */
+            if (tile->flags & FLAG_FLAGGED)
+                ms.flagged += undo ? 1 : -1;
+        }
+    }
+
+    ms.playing = undo ? move->playing_before : move->playing_after;
+    feed_move(move, undo);
+    shm_move(move, undo);
+}
+
+/**
+ * @brief Reverts the last move in the journal
+ * @return False if there was nothing to undo
+ */
+static bool journal_undo(void) {
+    if (journal.cur == 0)
+        return false;
+
+    journal_apply(&journal.moves[--journal.cur], true);
+    return true;
+}
+
+/**
+ * @brief Applies again the last undone move in the journal
+ * @return False if there was nothing to redo
+ */
+static bool journal_redo(void) {
+    if (journal.cur >= journal.moves_num)
+        return false;
+
+    journal_apply(&journal.moves[journal.cur++], false);
+    return true;
+}
+
+/**
+ * @brief Sets the FLAG_CLEARED bit of a tile, and records it in the journal
+ * @details Does nothing if the tile was already revealed. The flag of the tile
+ * is kept for undoing the reveal, but it's no longer counted in ms.flagged.
+ * @param[in] idx Index of the tile in ms.grid
+ */
+static inline void reveal_tile(int idx) {
+    Tile* tile = tile_get(idx);
+    if (tile->flags & FLAG_CLEARED)
+        return;
+
+    tile->flags |= FLAG_CLEARED;
+    if (tile->flags & FLAG_FLAGGED)
+        ms.flagged--;
+
+    journal_record(idx);
+}
 
 /*----------------------------------------------------------------------------*/
 
@@ -159,9 +829,84 @@ static inline bool parse_args(int argc, char** argv) {
                             "    <LMouse> - Reveal clicked bomb\n"
                             "    <RMouse> - Flag clicked bomb\n"
 #endif
+                            "           u - Undo last move\n"
+                            "    <Ctrl-R> - Redo undone move\n"
+                            "           ? - Show a tile that can be deduced\n"
                             "           r - Reveal all tiles and end game\n"
                             "           q - Quit the game\n");
             return false;
+        } else if (!strcmp(argv[i], "-S") || !strcmp(argv[i], "--seed")) {
+            if (i == argc - 1) {
+                fprintf(stderr, "Not enough arguments for \"%s\"\n", argv[i]);
+                arg_error = true;
+                break;
+            }
+
+            char* end;
+            seed     = strtoull(argv[++i], &end, 0);
+            use_seed = true;
+            if (*argv[i] == '\0' || *end != '\0') {
+                fprintf(stderr, "Invalid seed format for \"%s\".\n",
+                        argv[i - 1]);
+                arg_error = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-A") || !strcmp(argv[i], "--analyze")) {
+            if (i == argc - 1) {
+                fprintf(stderr, "Not enough arguments for \"%s\"\n", argv[i]);
+                arg_error = true;
+                break;
+            }
+
+            /* strtoull() would accept "-1" as the largest number */
+            char* end;
+            analyze_count = strtoull(argv[++i], &end, 0);
+            if (!isdigit(*argv[i]) || *end != '\0' || analyze_count == 0) {
+                fprintf(stderr, "Invalid number of boards for \"%s\".\n",
+                        argv[i - 1]);
+                arg_error = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-b") || !strcmp(argv[i], "--bench")) {
+            if (i == argc - 1) {
+                fprintf(stderr, "Not enough arguments for \"%s\"\n", argv[i]);
+                arg_error = true;
+                break;
+            }
+
+            char* end;
+            const unsigned long long boards = strtoull(argv[++i], &end, 0);
+            if (!isdigit(*argv[i]) || *end != '\0' || boards == 0 ||
+                boards > BENCH_MAX_BOARDS) {
+                fprintf(stderr,
+                        "Invalid number of boards for \"%s\".\n"
+                        "Boards range: 1-%d\n",
+                        argv[i - 1], BENCH_MAX_BOARDS);
+                arg_error = true;
+                break;
+            }
+
+            bench_boards = boards;
+        } else if (!strcmp(argv[i], "-F") || !strcmp(argv[i], "--feed")) {
+            if (i == argc - 1) {
+                fprintf(stderr, "Not enough arguments for \"%s\"\n", argv[i]);
+                arg_error = true;
+                break;
+            }
+
+            feed_path = argv[++i];
+        } else if (!strcmp(argv[i], "-m") || !strcmp(argv[i], "--shm")) {
+            if (i == argc - 1) {
+                fprintf(stderr, "Not enough arguments for \"%s\"\n", argv[i]);
+                arg_error = true;
+                break;
+            }
+
+            shm_name = argv[++i];
+        } else if (!strcmp(argv[i], "-a") || !strcmp(argv[i], "--ansi")) {
+            use_ansi = true;
+        } else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--stats")) {
+            show_stats = true;
         } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
             arg_error = true;
             break;
@@ -184,198 +929,725 @@ static inline bool parse_args(int argc, char** argv) {
                 "    %s -d N              - Same as --difficulty\n",
                 argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
                 argv[0], argv[0]);
+        fprintf(stderr,
+                "    %s --ansi            - Draw the grid with ANSI escapes "
+                "instead of ncurses\n"
+                "    %s -a                - Same as --ansi\n"
+                "    %s --stats           - Print frame statistics on exit\n"
+                "    %s -s                - Same as --stats\n"
+                "    %s --seed N          - Compute the bombs from seed N, "
+                "increased after each game\n"
+                "    %s -S N              - Same as --seed\n"
+                "    %s --analyze N       - Print CSV histograms of N boards "
+                "and exit\n"
+                "    %s -A N              - Same as --analyze\n"
+                "    %s --feed PATH       - Write the moves to a file, FIFO or "
+                "socket\n"
+                "    %s -F PATH           - Same as --feed\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+                argv[0], argv[0], argv[0]);
+        fprintf(stderr,
+                "    %s --shm NAME        - Share the board with bots in the "
+                "shared memory NAME\n"
+                "    %s -m NAME           - Same as --shm\n"
+                "    %s --bench N         - Measure the speed of the batch "
+                "environment with N boards\n"
+                "    %s -b N              - Same as --bench\n",
+                argv[0], argv[0], argv[0], argv[0]);
         return false;
     }
 
-    return true;
+    return true;
+}
+
+/**
+ * @brief Draws the grid border for the minesweeper
+ */
+static void draw_border(void) {
+    BOLD_ON();
+    SET_COL(COL_NORM);
+
+    /* First line */
+    mvaddch(0, 0, '+');
+    for (int x = 0; x < ms.w; x++)
+        mvaddch(0, x + 1, '-');
+    mvaddch(0, ms.w + 1, '+');
+
+    /* Mid lines */
+    for (int y = 1; y <= ms.h; y++) {
+        mvaddch(y, 0, '|');
+        mvaddch(y, ms.w + 1, '|');
+    }
+
+    /* Last line */
+    mvaddch(ms.h + 1, 0, '+');
+    for (int x = 0; x < ms.w; x++)
+        mvaddch(ms.h + 1, x + 1, '-');
+    mvaddch(ms.h + 1, ms.w + 1, '+');
+
+    RESET_COL(COL_NORM);
+    BOLD_OFF();
+}
+
+/**
+ * @brief Initializes the empty background grid for the ms_t struct
+ * @details Writes every tile, so it should only be needed once after
+ * allocating the grid, and when the epoch counter wraps around.
+ */
+static inline void init_grid(void) {
+    for (int y = 0; y < ms.h; y++) {
+        for (int x = 0; x < ms.w; x++) {
+            ms.grid[y * ms.w + x].c     = CH_BACK;
+            ms.grid[y * ms.w + x].flags = FLAG_NONE;
+            ms.grid[y * ms.w + x].epoch = ms.epoch;
+        }
+    }
+}
+
+/**
+ * @brief Starts a new empty game
+ * @details Instead of clearing the grid, it increases the epoch so all the old
+ * tiles are read as empty and hidden.
+ */
+static inline void new_game(void) {
+    ms.mode       = MODE_NONE;
+    ms.bombs      = 0;
+    ms.flagged    = 0;
+    ms.t_start    = 0;
+    ms.t_end      = 0;
+    journal_clear();
+
+    /* Old tiles with the new epoch would be read as valid, clear them */
+    if (++ms.epoch == 0)
+        init_grid();
+
+    ms.playing = PLAYING_CLEAR;
+    feed_printf("n %d %d\n", ms.w, ms.h);
+    shm_refresh(SHM_READY);
+}
+
+/**
+ * @brief Returns the number of bombs adjacent to a specified tile
+ * @details Adjacent meaning in a 3x3 grid with the speicified tile at its
+ * center. Uses the counts precomputed by generate_grid().
+ * @param[in] p Position of the tile to check
+ * @return Number of bombs adjacent
+ */
+static inline int adjacent_bombs(vec2_t p) {
+    /* The grid has no bombs until the first reveal */
+    if (ms.playing == PLAYING_CLEAR)
+        return 0;
+
+    return openings.counts[p.y * ms.w + p.x];
+}
+
+/**
+ * @brief Prints the specified message 2 lines bellow `ms`'s grid
+ * @param[in] str String to be printed
+ */
+static void print_message(const char* str) {
+    int y, x;
+    getyx(stdscr, y, x);
+
+    SET_COL(COL_NORM);
+    mvprintw(ms.h + 3, 1, "%s", str);
+    RESET_COL(COL_NORM);
+
+    move(y, x);
+}
+
+/**
+ * @brief Clears a line in the screen
+ * @details Doesn't change the cursor position
+ * @param[in] y Line number starting from 0 to clear
+ */
+static inline void clear_line(int y) {
+    int oy, ox;
+    getyx(stdscr, oy, ox);
+
+    move(y, 0);
+    clrtoeol();
+
+    move(oy, ox);
+}
+
+/**
+ * @brief Returns how the tile at the specified position should be drawn
+ * @param[in] p Position of the tile
+ * @param[out] col Color of the tile (see color_ids enum)
+ * @param[out] bold True if the tile should be drawn in bold
+ * @return Char that should be drawn for the tile
+ */
+static char tile_look(vec2_t p, int* col, bool* bold) {
+    const int idx       = p.y * ms.w + p.x;
+    const uint8_t flags = tile_flags(idx);
+
+    *bold = false;
+
+    if (flags & FLAG_CLEARED) {
+        const int bombs = adjacent_bombs(p);
+        if (tile_char(idx) == CH_BOMB) {
+            /* Bomb (we lost) */
+            *col = COL_BOMB;
+            return CH_BOMB;
+        } else if (bombs) {
+            /* 5 -> COL_5. See color_ids enum in defines.h */
+            *col  = bombs;
+            *bold = true;
+
+            /* Number */
+            return bombs + '0';
+        } else {
+            /* Empty tile with no bombs adjacent */
+            *col = COL_NORM;
+            return tile_char(idx);
+        }
+    } else if (flags & FLAG_FLAGGED) {
+        *col  = COL_FLAG;
+        *bold = true;
+        return CH_FLAG;
+    } else {
+        *col = COL_UNK;
+        return CH_UNKN;
+    }
+}
+
+/**
+ * @brief Redraws the grid based on the ms.grid array
+ * @details Color macros will only do something if color is enabled and
+ * supported.
+ */
+static void redraw_grid(void) {
+    const int border_sz = 1;
+
+    draw_border();
+
+    for (int y = 0; y < ms.h; y++) {
+        for (int x = 0; x < ms.w; x++) {
+            int final_col;
+            bool final_bold;
+            const char final_ch = tile_look((vec2_t){ x, y }, &final_col,
+                                            &final_bold);
+
+            if (final_bold)
+                BOLD_ON();
+            SET_COL(final_col);
+
+            mvaddch(y + border_sz, x + border_sz, final_ch);
+
+            RESET_COL(final_col);
+            BOLD_OFF();
+        }
+    }
+}
+
+/**
+ * @brief Fills the ansi_esc array and allocates the ANSI frame buffer
+ * @details Should be called after initializing the colors. The escapes mimic
+ * the ncurses color pairs, so both backends look the same.
+ */
+static void ansi_init(void) {
+    for (int bold = 0; bold <= 1; bold++) {
+        for (int col = 0; col <= COL_UNK; col++) {
+            if (use_color)
+                snprintf(ansi_esc[bold][col], sizeof(ansi_esc[bold][col]),
+                         "\x1b[0;%s3%d;4%dm", bold ? "1;" : "", color_fg[col],
+                         COLOR_BLACK);
+            else
+                snprintf(ansi_esc[bold][col], sizeof(ansi_esc[bold][col]),
+                         "\x1b[0m");
+        }
+    }
+
+    /* Hashes are zero, so every row will be drawn in the first frame */
+    frame.row_hashes = calloc(ms.h + 2, sizeof(uint64_t));
+}
+
+/**
+ * @brief Makes the ANSI backend draw every row in the next frame
+ * @details Should be called when ncurses repaints the whole screen, since that
+ * erases the grid drawn behind its back.
+ */
+static void ansi_invalidate(void) {
+    if (frame.row_hashes != NULL)
+        memset(frame.row_hashes, 0, (ms.h + 2) * sizeof(uint64_t));
+}
+
+/**
+ * @brief Makes sure the frame buffer can hold `sz` more bytes
+ * @param[in] sz Number of bytes that will be appended
+ */
+static void frame_reserve(size_t sz) {
+    if (frame.len + sz <= frame.cap)
+        return;
+
+    size_t new_cap = frame.cap ? frame.cap * 2 : 4096;
+    while (new_cap < frame.len + sz)
+        new_cap *= 2;
+
+    frame.data = realloc(frame.data, new_cap);
+    frame.cap  = new_cap;
+}
+
+/**
+ * @brief Returns the FNV-1a hash of the specified bytes
+ * @details Used for detecting rows that didn't change since the last frame.
+ */
+static uint64_t hash_bytes(const char* data, size_t sz) {
+    uint64_t ret = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < sz; i++) {
+        ret ^= (uint8_t)data[i];
+        ret *= 0x100000001B3ULL;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Writes all the bytes to a file descriptor, retrying if needed
+ * @param[in] fd File descriptor to write to
+ * @param[in] data Bytes to write
+ * @param[in] sz Number of bytes
+ */
+static void write_all(int fd, const char* data, size_t sz) {
+    while (sz > 0) {
+        const ssize_t written = write(fd, data, sz);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return;
+        }
+
+        data += written;
+        sz -= written;
+    }
+}
+
+/**
+ * @brief Redraws the grid and its border using the ANSI backend
+ * @details Builds every changed row into the frame buffer, grouping adjacent
+ * cells with the same color so each run only needs one escape sequence, and
+ * writes the whole frame with a single write() call.
+ */
+static void ansi_redraw_grid(void) {
+    /* Cursor position, worst case escape for each cell, and the reset */
+    const size_t max_row_sz =
+      16 + (ms.w + 2) * (sizeof(ansi_esc[0][0]) + 1) + 8;
+
+    frame.len = 0;
+
+    for (int y = 0; y < ms.h + 2; y++) {
+        frame_reserve(max_row_sz);
+
+        const size_t row_start = frame.len;
+        char* out              = &frame.data[frame.len];
+        out += sprintf(out, "\x1b[%d;1H", y + 1);
+
+        const char* cur_esc = NULL;
+        for (int x = 0; x < ms.w + 2; x++) {
+            int col   = COL_NORM;
+            bool bold = true;
+            char ch;
+
+            if (y == 0 || y == ms.h + 1)
+                ch = (x == 0 || x == ms.w + 1) ? '+' : '-';
+            else if (x == 0 || x == ms.w + 1)
+                ch = '|';
+            else
+                ch = tile_look((vec2_t){ x - 1, y - 1 }, &col, &bold);
+
+            /* Same as the color macros, no bold without color */
+            if (!use_color) {
+                col  = COL_NORM;
+                bold = false;
+            }
+
+            /* Only change the attributes at the start of a new run */
+            const char* esc = ansi_esc[bold][col];
+            if (esc != cur_esc) {
+                const size_t esc_len = strlen(esc);
+                memcpy(out, esc, esc_len);
+                out += esc_len;
+                cur_esc = esc;
+            }
+
+            *out++ = ch;
+        }
+
+        frame.len = out - frame.data;
+
+        /* If the row is the same as in the last frame, don't send it */
+        const uint64_t hash =
+          hash_bytes(&frame.data[row_start], frame.len - row_start);
+        if (hash == frame.row_hashes[y])
+            frame.len = row_start;
+        else
+            frame.row_hashes[y] = hash;
+    }
+
+    if (frame.len == 0)
+        return;
+
+    frame_reserve(sizeof("\x1b[0m"));
+    memcpy(&frame.data[frame.len], "\x1b[0m", sizeof("\x1b[0m") - 1);
+    frame.len += sizeof("\x1b[0m") - 1;
+
+    write_all(STDOUT_FILENO, frame.data, frame.len);
 }
 
 /**
- * @brief Draws the grid border for the minesweeper
+ * @brief Returns the current time of the monotonic clock in nanoseconds
  */
-static void draw_border(void) {
-    BOLD_ON();
-    SET_COL(COL_NORM);
+static inline uint64_t now_nsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
-    /* First line */
-    mvaddch(0, 0, '+');
-    for (int x = 0; x < ms.w; x++)
-        mvaddch(0, x + 1, '-');
-    mvaddch(0, ms.w + 1, '+');
+/**
+ * @brief Returns the total bytes written by the process, from `io_fd`
+ * @return Value of the `wchar` counter, or 0 on error
+ */
+static uint64_t written_bytes(void) {
+    char buf[512];
+    const ssize_t sz = pread(io_fd, buf, sizeof(buf) - 1, 0);
+    if (sz <= 0)
+        return 0;
+    buf[sz] = '\0';
+
+    const char* wchar = strstr(buf, "wchar: ");
+    return wchar ? strtoull(wchar + sizeof("wchar: ") - 1, NULL, 10) : 0;
+}
 
-    /* Mid lines */
-    for (int y = 1; y <= ms.h; y++) {
-        mvaddch(y, 0, '|');
-        mvaddch(y, ms.w + 1, '|');
-    }
+/**
+ * @brief Returns the nanoseconds spent in the current game
+ * @return Elapsed time, or 0 if the game didn't start
+ */
+static inline uint64_t elapsed_nsecs(void) {
+    if (ms.t_start == 0)
+        return 0;
 
-    /* Last line */
-    mvaddch(ms.h + 1, 0, '+');
-    for (int x = 0; x < ms.w; x++)
-        mvaddch(ms.h + 1, x + 1, '-');
-    mvaddch(ms.h + 1, ms.w + 1, '+');
+    return (ms.t_end ? ms.t_end : now_nsecs()) - ms.t_start;
+}
+
+/**
+ * @brief Prints the elapsed time, the remaining mines and the 3BV 1 line
+ * bellow `ms`'s grid
+ * @details Doesn't refresh the screen or change the cursor position
+ */
+static void print_status(void) {
+    int y, x;
+    getyx(stdscr, y, x);
 
+    const uint64_t secs = elapsed_nsecs() / 1000000000ULL;
+
+    SET_COL(COL_NORM);
+    if (ms.playing == PLAYING_CLEAR)
+        mvprintw(ms.h + 2, 1, "Time: %02d:%02d  Mines left: -", 0, 0);
+    else
+        mvprintw(ms.h + 2, 1, "Time: %02llu:%02llu  Mines left: %ld  3BV: %u",
+                 (unsigned long long)(secs / 60),
+                 (unsigned long long)(secs % 60),
+                 (long)ms.bombs - (long)ms.flagged, openings.bbbv);
+    clrtoeol();
     RESET_COL(COL_NORM);
-    BOLD_OFF();
+
+    move(y, x);
 }
 
 /**
- * @brief Initializes the empty background grid for the ms_t struct
+ * @brief Draws the grid and messages, and moves the cursor
+ * @details Uses the ANSI backend if `use_ansi` is true, and ncurses otherwise.
+ * The time spent is accumulated in `frame_stats`.
+ * @param[in] cursor Position of the user cursor in the grid
  */
-static inline void init_grid(void) {
-    for (int y = 0; y < ms.h; y++) {
-        for (int x = 0; x < ms.w; x++) {
-            ms.grid[y * ms.w + x].c     = CH_BACK;
-            ms.grid[y * ms.w + x].flags = FLAG_NONE;
-        }
+static void draw_frame(vec2_t cursor) {
+    const int border_sz = 1;
+    struct timespec start, end;
+
+    /* Before starting the clock, so the frame time doesn't include it */
+    const uint64_t written = (io_fd >= 0) ? written_bytes() : 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (use_ansi) {
+        /* Messages are still drawn by ncurses. Refresh before drawing the
+         * grid, so the initial clear of ncurses doesn't erase it. If this
+         * refresh clears the screen (e.g. after clearok()), every row of the
+         * grid has to be sent again. */
+        print_status();
+        if (is_cleared(curscr))
+            ansi_invalidate();
+        refresh();
+
+        ansi_redraw_grid();
+
+        /* We moved the terminal cursor behind the back of ncurses, so use
+         * absolute addressing and let it know the new position */
+        mvcur(-1, -1, cursor.y + border_sz, cursor.x + border_sz);
+        fflush(stdout);
+    } else {
+        redraw_grid();
+        print_status();
+
+        /* Update the cursor (+margins) */
+        move(cursor.y + border_sz, cursor.x + border_sz);
+
+        /* Refresh screen */
+        refresh();
     }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    frame_last    = start.tv_sec * 1000000000ULL + start.tv_nsec;
+    frame_pending = false;
+
+    frame_stats.frames++;
+    frame_stats.nsecs += (end.tv_sec - start.tv_sec) * 1000000000ULL +
+                         end.tv_nsec - start.tv_nsec;
+
+    if (io_fd >= 0)
+        frame_stats.bytes += written_bytes() - written;
 }
 
 /**
- * @brief Returns the number of bombs adjacent to a specified tile
- * @details Adjacent meaning in a 3x3 grid with the speicified tile at its
- * center.
- * @param[in] p Position of the tile to check
- * @return Number of bombs adjacent
+ * @brief Redraws only the status line, and moves the cursor back
+ * @param[in] cursor Position of the user cursor in the grid
  */
-static int adjacent_bombs(vec2_t p) {
-    int ret = 0;
-
-    const vec2_t start = {
-        .y = (p.y > 0) ? p.y - 1 : p.y,
-        .x = (p.x > 0) ? p.x - 1 : p.x,
-    };
+static void draw_status(vec2_t cursor) {
+    const int border_sz = 1;
 
-    const vec2_t end = {
-        .y = (p.y < ms.h - 1) ? p.y + 1 : p.y,
-        .x = (p.x < ms.w - 1) ? p.x + 1 : p.x,
-    };
+    print_status();
 
-    /* ###
-     * #X#
-     * ### */
-    vec2_t cur;
-    for (cur.y = start.y; cur.y <= end.y; cur.y++)
-        for (cur.x = start.x; cur.x <= end.x; cur.x++)
-            if (HAS_CHAR(cur, CH_BOMB))
-                ret++;
+    if (use_ansi) {
+        refresh();
 
-    return ret;
+        /* Same as in draw_frame(), we can't know where ncurses left it */
+        mvcur(-1, -1, cursor.y + border_sz, cursor.x + border_sz);
+        fflush(stdout);
+    } else {
+        move(cursor.y + border_sz, cursor.x + border_sz);
+        refresh();
+    }
 }
 
 /**
- * @brief Prints the specified message 2 lines bellow `ms`'s grid
- * @param[in] str String to be printed
+ * @brief Starts, stops or resumes the game clock depending on ms.playing
+ * @details The status timer is only armed while the clock is running, so the
+ * process doesn't wake up while idle. Ticks are aligned to whole intervals of
+ * the elapsed time.
  */
-static void print_message(const char* str) {
-    int y, x;
-    getyx(stdscr, y, x);
+static void update_clock(void) {
+    const uint64_t interval = STATUS_INTERVAL * 1000000ULL;
+    const uint64_t now      = now_nsecs();
+
+    if (ms.playing == PLAYING_TRUE) {
+        if (ms.t_start == 0) {
+            /* First move of the game */
+            ms.t_start = now;
+        } else if (ms.t_end != 0) {
+            /* The end of the game was undone, skip the time in between */
+            ms.t_start += now - ms.t_end;
+            ms.t_end = 0;
+        }
+    } else if (ms.t_start != 0 && ms.t_end == 0) {
+        /* Game over */
+        ms.t_end = now;
+    }
 
-    SET_COL(COL_NORM);
-    mvprintw(ms.h + 3, 1, "%s", str);
-    RESET_COL(COL_NORM);
+    const bool running = ms.playing == PLAYING_TRUE;
+    if (timer_fd < 0 || running == timer_armed)
+        return;
 
-    move(y, x);
+    struct itimerspec spec = { 0 };
+    if (running) {
+        const uint64_t next = interval - elapsed_nsecs() % interval;
+
+        spec.it_value.tv_sec     = next / 1000000000ULL;
+        spec.it_value.tv_nsec    = next % 1000000000ULL;
+        spec.it_interval.tv_sec  = interval / 1000000000ULL;
+        spec.it_interval.tv_nsec = interval % 1000000000ULL;
+    }
+
+    /* A zero it_value disarms the timer */
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+    timer_armed = running;
 }
 
 /**
- * @brief Clears a line in the screen
- * @details Doesn't change the cursor position
- * @param[in] y Line number starting from 0 to clear
+ * @brief Returns true if a frame was skipped and it should be drawn now
+ * @param[in] now Current monotonic time
  */
-static inline void clear_line(int y) {
-    int oy, ox;
-    getyx(stdscr, oy, ox);
+static inline bool frame_due(uint64_t now) {
+    return frame_pending && now - frame_last >= FRAME_INTERVAL * 1000000ULL;
+}
 
-    move(y, 0);
-    clrtoeol();
+/**
+ * @brief Returns how long wait_key() can sleep before checking `shm_board`
+ * @details Right after an action it doesn't sleep for SHM_SPIN_TIME, so a bot
+ * waiting for the result of each move is not slowed down by poll(). Then, the
+ * sleep doubles each time up to SHM_SLEEP_MAX, so an idle bot costs almost no
+ * CPU. It's also shortened for drawing a pending frame on time.
+ * @param[in] now Current monotonic time
+ * @return Timeout for poll() in milliseconds
+ */
+static int shm_timeout(uint64_t now) {
+    if (now - shm_last_action < SHM_SPIN_TIME * 1000ULL)
+        return 0;
+
+    int ret = shm_sleep;
+    if (shm_sleep < SHM_SLEEP_MAX)
+        shm_sleep *= 2;
+
+    if (frame_pending) {
+        const uint64_t due  = frame_last + FRAME_INTERVAL * 1000000ULL;
+        const int due_msecs = (due - now + 999999) / 1000000;
+        if (due_msecs < ret)
+            ret = due_msecs;
+    }
 
-    move(oy, ox);
+    return ret;
 }
 
 /**
- * @brief Redraws the grid based on the ms.grid array
- * @details Color macros will only do something if color is enabled and
- * supported.
+ * @brief Waits for the next key, updating the status line meanwhile
+ * @details Sleeps in poll() until there is input or the status timer expires,
+ * so no CPU is used while idle. If `shm_board` is open, it's checked between
+ * the calls to poll() (see shm_timeout()). Queued actions are checked before
+ * the keyboard, so a batch of them doesn't cost a call to getch() each, but
+ * the keyboard is still checked every SHM_BATCH actions.
+ * @param[in] cursor Position of the user cursor in the grid
+ * @return Key returned by getch(), or KEY_SHM if there are actions to process
  */
-static void redraw_grid(void) {
-    const int border_sz = 1;
+static int wait_key(vec2_t cursor) {
+    struct pollfd fds[] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = timer_fd, .events = POLLIN },
+        { .fd = -1, .events = POLLOUT },
+    };
 
-    draw_border();
+    for (;;) {
+        if (shm_board != NULL && shm_batch < SHM_BATCH &&
+            shm_board_pending(shm_board)) {
+            shm_batch++;
+            shm_last_action = now_nsecs();
+            shm_sleep       = 1;
+            return KEY_SHM;
+        }
 
-    for (int y = 0; y < ms.h; y++) {
-        for (int x = 0; x < ms.w; x++) {
-            const int final_y = y + border_sz;
-            const int final_x = x + border_sz;
-            int final_col     = COL_NORM;
-            char final_ch     = 0;
-
-            if (ms.grid[y * ms.w + x].flags & FLAG_CLEARED) {
-                const int bombs = adjacent_bombs((vec2_t){ x, y });
-                if (ms.grid[y * ms.w + x].c == CH_BOMB) {
-                    /* Bomb (we lost) */
-                    final_col = COL_BOMB;
-                    final_ch  = CH_BOMB;
-                } else if (bombs) {
-                    BOLD_ON();
-                    /* 5 -> COL_5. See color_ids enum in defines.h */
-                    final_col = bombs;
-
-                    /* Number */
-                    final_ch = bombs + '0';
-                } else {
-                    /* Empty tile with no bombs adjacent */
-                    final_col = COL_NORM;
-                    final_ch  = ms.grid[y * ms.w + x].c;
-                }
-            } else if (ms.grid[y * ms.w + x].flags & FLAG_FLAGGED) {
-                BOLD_ON();
-                final_col = COL_FLAG;
-                final_ch  = CH_FLAG;
-            } else {
-                final_col = COL_UNK;
-                final_ch  = CH_UNKN;
+        /* Non-blocking, ncurses might have some keys buffered */
+        shm_batch   = 0;
+        const int c = getch();
+        if (c != ERR)
+            return c;
+
+        int timeout = -1;
+        if (shm_board != NULL) {
+            const uint64_t now = now_nsecs();
+
+            if (shm_board_pending(shm_board)) {
+                shm_batch       = 1;
+                shm_last_action = now;
+                shm_sleep       = 1;
+                return KEY_SHM;
             }
 
-            SET_COL(final_col);
+            /* The queue is empty, show the frames skipped by main() */
+            if (frame_due(now))
+                draw_frame(cursor);
 
-            mvaddch(final_y, final_x, final_ch);
+            /* While spinning, let a bot on the same core run */
+            timeout = shm_timeout(now);
+            if (timeout == 0)
+                sched_yield();
+        }
 
-            RESET_COL(final_col);
-            BOLD_OFF();
+        /* Only wake up for the feed if there is something to write */
+        fds[2].fd = feed_poll_fd();
+
+        if (poll(fds, 3, timeout) < 0 && errno != EINTR)
+            return ERR;
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                draw_status(cursor);
         }
+
+        if (fds[2].revents & (POLLOUT | POLLERR | POLLHUP))
+            feed_flush();
     }
 }
 
+/**
+ * @brief Prints the accumulated frame statistics to stderr
+ * @details Should be called after closing ncurses.
+ */
+static void print_frame_stats(void) {
+    if (frame_stats.frames == 0)
+        return;
+
+    fprintf(stderr,
+            "Backend: %s\n"
+            "Frames: %llu\n"
+            "Average frame time: %.2f us\n",
+            use_ansi ? "ANSI" : "ncurses",
+            (unsigned long long)frame_stats.frames,
+            (double)frame_stats.nsecs / frame_stats.frames / 1000.0);
+
+    if (io_fd >= 0)
+        fprintf(stderr, "Average bytes per frame: %.1f\n",
+                (double)frame_stats.bytes / frame_stats.frames);
+}
+
+/**
+ * @brief Computes the counts, openings and 3BV of the generated grid
+ * @details The bombs should already be in the count plane. Each opening is
+ * labeled once, storing the list of tiles it reveals (see board_openings()).
+ * This way, reveal_tiles() doesn't need to check the neighbors of each tile.
+ * Also sets ms.bombs.
+ */
+static void compute_openings(void) {
+    /* On error, empty tiles will only reveal themselves */
+    board_openings(&openings, ms.w, ms.h);
+    ms.bombs = openings.bombs;
+}
+
 /**
  * @brief Fill the grid with bombs at random locations
  * @details Will leave a margin area around the first user selection (so it
- * never reveals a bomb on the first input).
+ * never reveals a bomb on the first input). If `use_seed` is true, the bombs
+ * are not stored, and they will be computed from the seed when reading each
+ * tile (see stateless_char()).
  * @param[in] start Position of the first tile that the user tried to reveal
  * @param[in] bomb_percent The percentage of bombs to fill
  */
 static void generate_grid(vec2_t start, int bomb_percent) {
-    int total_bombs = ms.h * ms.w * bomb_percent / 100;
-
-    /* Actual tiles available for bombs (keep in mind the empty zone around the
-     * cursor) */
-    const int max_bombs = ms.w * ms.h - BOMB_MARGIN * 4;
-    if (total_bombs > max_bombs)
-        total_bombs = max_bombs;
-
-    for (int bombs = 0; bombs < total_bombs; bombs++) {
-        int bomb_y = (uint32_t)rand() % ms.h;
-        int bomb_x = (uint32_t)rand() % ms.w;
-
-        /* Leave an empty zone around cursor */
-        if (bomb_y > start.y - BOMB_MARGIN && bomb_y < start.y + BOMB_MARGIN &&
-            bomb_x > start.x - BOMB_MARGIN && bomb_x < start.x + BOMB_MARGIN) {
-            bombs--;
-            continue;
-        }
-
-        ms.grid[bomb_y * ms.w + bomb_x].c = CH_BOMB;
+    if (use_seed) {
+        ms.seed     = seed++;
+        ms.start_x  = start.x;
+        ms.start_y  = start.y;
+        ms.bomb_pct = bomb_percent;
+        ms.mode |= MODE_STATELESS;
+
+        /* Same bombs as stateless_char(), but only for computing the counts */
+        board_stateless_bombs(openings.counts, ms.w, ms.h, start.x, start.y,
+                              bomb_percent, ms.seed);
+        compute_openings();
+        return;
     }
+
+    /* Same generator as `--analyze`, with a stream chosen by rand() */
+    const uint64_t ctr = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+    board_random_bombs(openings.counts, ms.w, ms.h, start.x, start.y,
+                       bomb_percent, ctr);
+
+    for (int idx = 0; idx < ms.w * ms.h; idx++)
+        if (openings.counts[idx] == COUNT_BOMB)
+            tile_get(idx)->c = CH_BOMB;
+
+    compute_openings();
 }
 
 /**
@@ -408,103 +1680,34 @@ static inline bool surrounding_bombs_flagged(vec2_t p) {
 }
 
 /**
- * @brief Check if the specified tile doesn't have the CLEARED flag set
- * @param[in] p Position to check
- * @return True if a valid position in the grid and if the CLEARED flag is not
- * set
- */
-static inline bool is_hidden(vec2_t p) {
-    return p.x >= 0 && p.x < ms.w && p.y >= 0 && p.y < ms.h &&
-           !HAS_FLAG(p, FLAG_CLEARED);
-}
-
-/**
- * @brief Check if the specified tile has any adjacent bombs
- * @param[in] p Position to check
- * @return True if a valid position in the grid and if it has no adjacent bombs
- */
-static inline bool is_empty(vec2_t p) {
-    return p.x >= 0 && p.x < ms.w && p.y >= 0 && p.y < ms.h &&
-           adjacent_bombs(p) == 0;
-}
-
-/**
- * @brief Pop value from the front of a 2d vector queue
- * @details Used by reveal_tiles()
- * @return Value at the front (index 0) of the queue
- */
-static inline vec2_t queue_pop_front(void) {
-    vec2_t ret = queue[0];
-
-    /* Shift. Note that `top` is not the last pushed value, but the next one */
-    queue_pos--;
-    for (int i = 0; i < queue_pos; i++)
-        queue[i] = queue[i + 1];
-
-    return ret;
-}
-
-/**
- * @brief Push value to the back of a 2d vector queue
- * @details Used by reveal_tiles()
- * @param[in] x Value to push
- */
-static inline void queue_push(vec2_t x) {
-    queue[queue_pos++] = x;
-}
-
-/**
- * @brief Reveals the needed tiles using recursion, starting at y and x
+ * @brief Reveals the needed tiles, starting at y and x
+ * @details If the tile is empty, reveals the whole opening precomputed by
+ * compute_openings().
  * @param[in] y, x Position to be revealed
  * @param[in] user_call Used to know if we are recursing in the current function
  * call or not
- *
- * @todo Don't malloc and free the queue in each call, alloc once as global
  */
 void reveal_tiles(vec2_t p, bool user_call) {
     if (user_call && HAS_CHAR(p, CH_BOMB)) {
         print_message("You lost. Press any key to restart.");
-        ms.grid[p.y * ms.w + p.x].flags |= FLAG_CLEARED;
+        REVEAL_TILE(p);
         ms.playing = PLAYING_FALSE;
         return;
     }
 
+    const bool was_hidden = !HAS_FLAG(p, FLAG_CLEARED);
     REVEAL_TILE(p);
 
     /* Current tile has no number in it */
     if (adjacent_bombs(p) == 0) {
-        /* Queue is allocated once globally */
-        queue_pos = 0;
-
-        /* Push parameter and reveal it */
-        queue_push(p);
-
-        /* Queue is not empty */
-        while (queue_pos > 0) {
-            const vec2_t cur = queue_pop_front();
-
-            /* Iterate adjacent, avoiding the middle tile (cur).
-             *  ...
-             *  .p.
-             *  ...  */
-            vec2_t iter;
-            for (iter.y = cur.y - 1; iter.y <= cur.y + 1; iter.y++) {
-                for (iter.x = cur.x - 1; iter.x <= cur.x + 1; iter.x++) {
-                    /* Skip middle tile */
-                    if (iter.x == cur.x && iter.y == cur.y)
-                        continue;
-
-                    /* If hidden, reveal */
-                    if (is_hidden(iter)) {
-                        REVEAL_TILE(iter);
-
-                        /* If we encounter another empty tile, push queue */
-                        if (is_empty(iter))
-                            queue_push(iter);
-                    }
-                }
-            }
-        }
+        /* Openings are always revealed at once, so if this tile was already
+         * revealed, so is the rest. */
+        const uint32_t id = openings.label[p.y * ms.w + p.x];
+        if (!was_hidden || id == NO_OPENING)
+            return;
+
+        for (uint32_t i = openings.start[id]; i < openings.start[id + 1]; i++)
+            reveal_tile(openings.tiles[i]);
     } else if (user_call && HAS_FLAG(p, FLAG_CLEARED) &&
                surrounding_bombs_flagged(p)) {
 #ifdef REVEAL_SURROUNDING
@@ -550,7 +1753,10 @@ static inline void toggle_flag(vec2_t p) {
         return;
     }
 
-    ms.grid[p.y * ms.w + p.x].flags ^= FLAG_FLAGGED;
+    Tile* tile = tile_get(p.y * ms.w + p.x);
+    tile->flags ^= FLAG_FLAGGED;
+    ms.flagged += (tile->flags & FLAG_FLAGGED) ? 1 : -1;
+    journal_record(p.y * ms.w + p.x);
 }
 
 /**
@@ -561,13 +1767,69 @@ static inline bool check_win(void) {
     for (int y = 0; y < ms.h; y++)
         for (int x = 0; x < ms.w; x++)
             /* If there is an unflagged bomb, return false */
-            if (ms.grid[y * ms.w + x].c == CH_BOMB &&
-                !(ms.grid[y * ms.w + x].flags & FLAG_FLAGGED))
+            if (tile_char(y * ms.w + x) == CH_BOMB &&
+                !(tile_flags(y * ms.w + x) & FLAG_FLAGGED))
                 return false;
 
     return true;
 }
 
+/**
+ * @brief Moves the cursor to a tile that can be deduced from the visible ones
+ * @details Prints whether the tile is safe or has a bomb, and the hit rate of
+ * the pattern table used by solver_hint().
+ * @param[inout] cursor Position of the user cursor in the grid
+ */
+static void show_hint(vec2_t* cursor) {
+    uint8_t* obs = malloc(ms.w * ms.h);
+    if (obs == NULL)
+        return;
+
+    for (int idx = 0; idx < ms.w * ms.h; idx++)
+        obs[idx] = tile_obs(idx);
+
+    SolverHint hint;
+    const bool found =
+      solver_hint(obs, ms.w, ms.h, cursor->x, cursor->y, &hint);
+    free(obs);
+
+    const SolverStats stats = solver_stats();
+    const double hit_rate   = 100.0 * stats.hits / (stats.hits + stats.misses);
+
+    char msg[128];
+    if (found) {
+        cursor->x = hint.x;
+        cursor->y = hint.y;
+        snprintf(msg, sizeof(msg), "Hint: this tile %s. Pattern hits: %.1f%%",
+                 hint.bomb ? "has a bomb" : "is safe", hit_rate);
+    } else {
+        snprintf(msg, sizeof(msg), "No tile can be deduced from the patterns.");
+    }
+
+    print_message(msg);
+}
+
+/**
+ * @brief Prints the counters of the pattern table to stderr
+ * @details Should be called after closing ncurses.
+ */
+static void print_solver_stats(void) {
+    const SolverStats stats = solver_stats();
+    const uint64_t lookups  = stats.hits + stats.misses;
+    if (lookups == 0)
+        return;
+
+    fprintf(stderr,
+            "Pattern lookups: %llu (%.1f%% hits)\n"
+            "Patterns stored: %llu\n",
+            (unsigned long long)lookups, 100.0 * stats.hits / lookups,
+            (unsigned long long)stats.entries);
+
+    if (stats.misses > 0)
+        fprintf(stderr, "Average solve time: %.2f us\n",
+                (double)stats.solve_nsecs / stats.misses / 1000.0);
+}
+
 /**
  * @brief Entry point of the program
  * @param[in] argc Number of arguments
@@ -582,16 +1844,78 @@ int main(int argc, char** argv) {
         .grid       = NULL,
         .playing    = PLAYING_FALSE,
         .difficulty = DEFAULT_DIFFICULTY,
+        .mode       = MODE_NONE,
+        .epoch      = 0,
     };
 
     /* Parse arguments before ncurses */
     if (!parse_args(argc, argv))
         return 1;
 
+    /* Analyze boards instead of playing, with the same options */
+    if (analyze_count > 0) {
+        const AnalyzeOpts opts = {
+            .w            = ms.w,
+            .h            = ms.h,
+            .bomb_percent = DIFFIC2BOMBPERCENT(ms.difficulty),
+            .boards       = analyze_count,
+            .stateless    = use_seed,
+            .seed         = use_seed ? seed : (uint64_t)time(NULL),
+        };
+
+        return analyze_boards(&opts, stdout) ? 0 : 1;
+    }
+
+    /* Step many boards at once instead of playing */
+    if (bench_boards > 0) {
+        if (ms.w > BATCH_MAX_W || ms.h > UINT8_MAX) {
+            fprintf(stderr, "Maximum resolution for \"--bench\": %dx%d\n",
+                    BATCH_MAX_W, UINT8_MAX);
+            return 1;
+        }
+
+        const BatchOpts opts = {
+            .w            = ms.w,
+            .h            = ms.h,
+            .bomb_percent = DIFFIC2BOMBPERCENT(ms.difficulty),
+            .boards       = bench_boards,
+            .seed         = use_seed ? seed : (uint64_t)time(NULL),
+        };
+
+        return batch_bench(&opts, BENCH_STEPS, stdout) ? 0 : 1;
+    }
+
+    /* Only when playing, the modes above don't write any events */
+    if (feed_path != NULL && !feed_open(feed_path)) {
+        fprintf(stderr, "Can't open feed \"%s\": %s\n", feed_path,
+                strerror(errno));
+        return 1;
+    }
+
+    if (shm_name != NULL) {
+        shm_board = shm_board_open(shm_name, ms.w, ms.h);
+        if (shm_board == NULL && errno == EEXIST) {
+            fprintf(stderr,
+                    "Shared memory \"%s\" is already in use. If no other game "
+                    "is using it, remove /dev/shm%s\n",
+                    shm_name, shm_name);
+            return 1;
+        } else if (shm_board == NULL) {
+            fprintf(stderr, "Can't create shared memory \"%s\": %s\n",
+                    shm_name, strerror(errno));
+            return 1;
+        }
+    }
+
+    /* Not fatal, the bytes per frame are just not printed */
+    if (show_stats)
+        io_fd = open("/proc/self/io", O_RDONLY);
+
     initscr();            /* Init ncurses */
     raw();                /* Scan input without pressing enter */
     noecho();             /* Don't print when typing */
     keypad(stdscr, true); /* Enable keypad (arrow keys) */
+    nodelay(stdscr, true); /* Don't block in getch(), see wait_key() */
 
 #ifdef USE_MOUSE
     /* Enable mouse support and declare ncurses mouse event */
@@ -606,34 +1930,38 @@ int main(int argc, char** argv) {
     if (use_color) {
         start_color();
 
-        init_pair(COL_NORM, COLOR_WHITE, COLOR_BLACK);
-        init_pair(COL_1, COLOR_CYAN, COLOR_BLACK);
-        init_pair(COL_2, COLOR_BLUE, COLOR_BLACK);
-        init_pair(COL_3, COLOR_GREEN, COLOR_BLACK);
-        init_pair(COL_4, COLOR_YELLOW, COLOR_BLACK);
-        init_pair(COL_5, COLOR_MAGENTA, COLOR_BLACK);
-        init_pair(COL_6, COLOR_MAGENTA, COLOR_BLACK);
-        init_pair(COL_7, COLOR_MAGENTA, COLOR_BLACK);
-        init_pair(COL_8, COLOR_MAGENTA, COLOR_BLACK);
-        init_pair(COL_9, COLOR_MAGENTA, COLOR_BLACK);
-        init_pair(COL_FLAG, COLOR_RED, COLOR_BLACK);
-        init_pair(COL_BOMB, COLOR_RED, COLOR_BLACK);
-        init_pair(COL_UNK, COLOR_WHITE, COLOR_BLACK);
+        for (int col = COL_NORM; col <= COL_UNK; col++)
+            init_pair(col, color_fg[col], COLOR_BLACK);
     }
 #endif
 
+    if (use_ansi) {
+        /* The grid is not in stdscr, so ncurses shouldn't move the cursor over
+         * it (it could redraw the chars it thinks are there) */
+        leaveok(stdscr, true);
+        ansi_init();
+    }
+
     /* Init random seed */
     srand(time(NULL));
 
-    /* Allocate global queue used by reveal_tiles() */
-    queue = malloc(ms.w * ms.h * sizeof(vec2_t));
+    /* Timer for the status line. If it fails, it will only change on input */
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    /* Allocate the buffers used by compute_openings() */
+    if (!openings_alloc(&openings, ms.w, ms.h)) {
+        endwin();
+        fprintf(stderr, "Can't allocate the openings of the grid\n");
+        return 1;
+    }
+
+    /* A single move can't change more tiles than the grid has */
+    journal.pending = malloc(ms.w * ms.h * sizeof(uint32_t));
 
     /* Allocate and initialize grid */
     ms.grid = malloc(ms.w * ms.h * sizeof(Tile));
     init_grid();
-    ms.playing = PLAYING_CLEAR;
-
-    redraw_grid();
+    new_game();
 
     /* User cursor in the grid, not the screen. Start at the middle. */
     vec2_t cursor = {
@@ -641,30 +1969,34 @@ int main(int argc, char** argv) {
         .x = (ms.w - 1) / 2,
     };
 
+    /* Action submitted by a bot, if c is KEY_SHM */
+    ShmAction action;
+
     /* Char the user is pressing */
     int c = 0;
     while (c != 'q') {
-        /* First, redraw the grid */
-        redraw_grid();
-
-        /* Update the cursor (+margins) */
-        move(cursor.y + 1, cursor.x + 1);
-
-        /* Refresh screen */
-        refresh();
+        /* First, redraw the grid and update the cursor. Bots can send actions
+         * much faster than the terminal can show them, so those are only drawn
+         * once per FRAME_INTERVAL. */
+        const uint64_t since_frame = now_nsecs() - frame_last;
+        if (c == KEY_SHM && since_frame < FRAME_INTERVAL * 1000000ULL)
+            frame_pending = true;
+        else
+            draw_frame(cursor);
 
         /* Wait for user input */
-        c = tolower(getch());
+        c = tolower(wait_key(cursor));
 
-        /* Clear the output line */
-        clear_line(ms.h + 3);
+        /* Clear the output line. Not for each action of a bot, the messages
+         * of the last one are kept until the user presses a key. */
+        if (c != KEY_SHM)
+            clear_line(ms.h + 3);
 
         /* If it's the first iteration on a new game, clear grid. We will only
-         * generate the bombs once we press space the first time */
-        if (ms.playing == PLAYING_FALSE) {
-            init_grid();
-            ms.playing = PLAYING_CLEAR;
-        }
+         * generate the bombs once we press space the first time. The last move
+         * of a finished game can still be undone. */
+        if (ms.playing == PLAYING_FALSE && c != 'u' && c != KEY_CTRLR)
+            new_game();
 
         /* Parse input. 'q' quits and there is vim-like navigation */
         switch (c) {
@@ -715,8 +2047,31 @@ int main(int argc, char** argv) {
                     }
                 }
                 break;
-            toggleFlag:
 #endif
+            case KEY_SHM:
+                if (!shm_board_pop(shm_board, &action))
+                    break;
+
+                if (action.type == SHM_NEW_GAME) {
+                    /* Finished games were already restarted above */
+                    if (ms.playing != PLAYING_CLEAR)
+                        new_game();
+                    break;
+                }
+
+                if (action.x >= ms.w || action.y >= ms.h)
+                    break;
+
+                /* Same as the mouse, move the cursor to the tile */
+                cursor.y = action.y;
+                cursor.x = action.x;
+
+                if (action.type == SHM_FLAG)
+                    goto toggleFlag;
+                else if (action.type == SHM_REVEAL)
+                    goto clearTile;
+                break;
+            toggleFlag:
             case 'f':
                 /* If we just started playing, but we don't have the bombs */
                 if (ms.playing == PLAYING_CLEAR) {
@@ -725,6 +2080,7 @@ int main(int argc, char** argv) {
                     break;
                 }
 
+                journal_begin(MOVE_FLAG);
                 toggle_flag(cursor);
 
                 if (check_win()) {
@@ -732,10 +2088,9 @@ int main(int argc, char** argv) {
                     ms.playing = PLAYING_FALSE;
                 }
 
+                journal_commit();
                 break;
-#ifdef USE_MOUSE
             clearTile:
-#endif
             case ' ':
                 /* Initialize the bombs once we reveal for the first time */
                 if (ms.playing == PLAYING_CLEAR) {
@@ -746,7 +2101,26 @@ int main(int argc, char** argv) {
                     break;
                 }
 
+                journal_begin(MOVE_REVEAL);
                 reveal_tiles(cursor, true);
+                journal_commit();
+                break;
+            case '?':
+                if (ms.playing == PLAYING_CLEAR) {
+                    print_message(
+                      "Can't ask for a hint before starting the game!");
+                    break;
+                }
+
+                show_hint(&cursor);
+                break;
+            case 'u':
+                if (!journal_undo())
+                    print_message("Nothing to undo.");
+                break;
+            case KEY_CTRLR:
+                if (!journal_redo())
+                    print_message("Nothing to redo.");
                 break;
             case 'r':
                 /* Generate if it's the first time playing */
@@ -758,11 +2132,21 @@ int main(int argc, char** argv) {
                 print_message("Revealing all tiles and aborting game. "
                               "Press any key to continue.");
 
-                for (int y = 0; y < ms.h; y++)
-                    for (int x = 0; x < ms.w; x++)
-                        ms.grid[y * ms.w + x].flags |= FLAG_CLEARED;
+                /* Read every tile as revealed until the next game */
+                ms.mode |= MODE_REVEALED;
+                journal_clear();
 
+                /* Don't scan the whole grid if nobody is reading */
+                if (feed_enabled()) {
+                    feed_printf("a\n");
+                    feed_reveal_run(0, ms.w * ms.h);
+                }
                 ms.playing = PLAYING_FALSE;
+                shm_refresh(SHM_ABORTED);
+                break;
+            case KEY_RESIZE:
+                /* ncurses cleared the screen, including the ANSI grid */
+                ansi_invalidate();
                 break;
             case KEY_CTRLC:
                 c = 'q';
@@ -771,9 +2155,42 @@ int main(int argc, char** argv) {
             default:
                 break;
         }
+
+        /* The move might have started, ended or resumed the game */
+        update_clock();
+
+        /* Write the events of this move, without blocking */
+        feed_flush();
+
+        if (c == KEY_SHM)
+            shm_done();
     }
 
+    feed_close();
+
+    if (shm_board != NULL)
+        shm_board_close(shm_board, shm_name);
+
+    if (timer_fd >= 0)
+        close(timer_fd);
+
+    free(journal.pending);
+    free(journal.moves);
+    free(journal.runs);
+    openings_free(&openings);
+    free(frame.data);
+    free(frame.row_hashes);
     free(ms.grid);
+    solver_free();
     endwin();
+
+    if (show_stats) {
+        print_frame_stats();
+        print_solver_stats();
+    }
+
+    if (io_fd >= 0)
+        close(io_fd);
+
     return 0;
 }
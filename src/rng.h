@@ -0,0 +1,62 @@
+#ifndef _RNG_H
+#define _RNG_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "defines.h" /* BOMB_MARGIN */
+
+/**
+ * @brief SplitMix64 finalizer, used as a counter-based random generator
+ * @details The output for each input is independent from the others, so any
+ * counter can be computed in any order, and from any thread.
+ * @param[in] x Counter to hash
+ * @return Pseudo-random 64-bit number
+ */
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Returns the random 64-bit number of a tile for the specified seed
+ * @param[in] seed Seed of the board
+ * @param[in] x, y Position of the tile
+ * @return Pseudo-random 64-bit number
+ */
+static inline uint64_t hash_tile(uint64_t seed, uint32_t x, uint32_t y) {
+    return splitmix64(seed ^ splitmix64(((uint64_t)y << 32) | x));
+}
+
+/**
+ * @brief Returns true if there is a bomb in a tile of a stateless board
+ * @details A tile has a bomb with a probability of `bomb_percent`%, and it only
+ * depends on the seed and the position. The safe zone around the first reveal
+ * must be applied by the caller (see in_safe_zone()).
+ * @param[in] seed Seed of the board
+ * @param[in] x, y Position of the tile
+ * @param[in] bomb_percent Percentage of bombs, from 0 to 100
+ * @return True if the tile has a bomb
+ */
+static inline bool stateless_bomb(uint64_t seed, uint32_t x, uint32_t y,
+                                  int bomb_percent) {
+    return hash_tile(seed, x, y) < (UINT64_MAX / 100) * bomb_percent;
+}
+
+/**
+ * @brief Returns true if a tile is in the zone without bombs around the first
+ * reveal
+ * @details The zone is the square of BOMB_MARGIN tiles from the first reveal,
+ * not counting the borders, so the first reveal is always an opening.
+ * @param[in] x, y Position of the tile
+ * @param[in] start_x, start_y Position of the first reveal
+ * @return True if the tile can't have a bomb
+ */
+static inline bool in_safe_zone(int x, int y, int start_x, int start_y) {
+    return y > start_y - BOMB_MARGIN && y < start_y + BOMB_MARGIN &&
+           x > start_x - BOMB_MARGIN && x < start_x + BOMB_MARGIN;
+}
+
+#endif /* _RNG_H */
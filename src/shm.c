@@ -0,0 +1,99 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>    /* O_CREAT, O_EXCL, O_RDWR */
+#include <unistd.h>   /* ftruncate, close */
+#include <sys/mman.h> /* shm_open, mmap */
+
+#include "shm.h"
+
+/**
+ * @brief Returns the size of the segment for a grid of the specified size
+ */
+static inline size_t board_size(uint16_t w, uint16_t h) {
+    return sizeof(ShmBoard) + (size_t)w * h;
+}
+
+/*----------------------------------------------------------------------------*/
+
+ShmBoard* shm_board_open(const char* name, uint16_t w, uint16_t h) {
+    const size_t sz = board_size(w, h);
+
+    /* Never reuse a segment, it could be mapped by another game */
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return NULL;
+
+    /* The new segment is empty, so it's filled with zeros */
+    if (ftruncate(fd, sz) < 0) {
+        const int saved_errno = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    ShmBoard* board =
+      mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (board == MAP_FAILED) {
+        const int saved_errno = errno;
+        shm_unlink(name);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    board->version = SHM_VERSION;
+    board->w       = w;
+    board->h       = h;
+    memset(board->tiles, OBS_HIDDEN, (size_t)w * h);
+
+    /* Readers can check the magic to know if the rest is initialized */
+    atomic_thread_fence(memory_order_release);
+    board->magic = SHM_MAGIC;
+
+    return board;
+}
+
+void shm_board_close(ShmBoard* board, const char* name) {
+    munmap(board, board_size(board->w, board->h));
+    shm_unlink(name);
+}
+
+void shm_board_begin(ShmBoard* board) {
+    const uint64_t seq =
+      atomic_load_explicit(&board->seq, memory_order_relaxed);
+    atomic_store_explicit(&board->seq, seq + 1, memory_order_relaxed);
+
+    /* The odd counter must be visible before any of the changes */
+    atomic_thread_fence(memory_order_release);
+}
+
+void shm_board_end(ShmBoard* board) {
+    const uint64_t seq =
+      atomic_load_explicit(&board->seq, memory_order_relaxed);
+    atomic_store_explicit(&board->seq, seq + 1, memory_order_release);
+}
+
+bool shm_board_pending(ShmBoard* board) {
+    return atomic_load_explicit(&board->head, memory_order_relaxed) !=
+           atomic_load_explicit(&board->tail, memory_order_acquire);
+}
+
+bool shm_board_pop(ShmBoard* board, ShmAction* dst) {
+    const uint32_t head =
+      atomic_load_explicit(&board->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&board->tail, memory_order_acquire))
+        return false;
+
+    *dst = board->actions[head % SHM_ACTIONS];
+
+    /* Only now the producer can overwrite the slot */
+    atomic_store_explicit(&board->head, head + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,189 @@
+#ifndef _SHM_H
+#define _SHM_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * @def SHM_MAGIC
+ * @brief Value of ShmBoard.magic once the segment is initialized ("MSWP")
+ */
+#define SHM_MAGIC 0x5057534DU
+
+/**
+ * @def SHM_VERSION
+ * @brief Version of the ShmBoard layout, increased on incompatible changes
+ */
+#define SHM_VERSION 1
+
+/**
+ * @def SHM_ACTIONS
+ * @brief Capacity of the action queue, must be a power of two
+ */
+#define SHM_ACTIONS 4096
+
+/**
+ * @enum obs_values
+ * @brief Observation of each tile in ShmBoard.tiles
+ * @details Revealed tiles without a bomb are their number of adjacent bombs,
+ * from 0 to 8.
+ */
+enum obs_values {
+    OBS_HIDDEN = 9,  /* Tile is not revealed */
+    OBS_FLAG   = 10, /* Tile is flagged and not revealed */
+    OBS_BOMB   = 11, /* Revealed tile with a bomb */
+};
+
+/**
+ * @enum shm_states
+ * @brief For ShmBoard.state
+ */
+enum shm_states {
+    SHM_READY   = 0, /* New game, the bombs are placed on the first reveal */
+    SHM_PLAYING = 1, /* Playing a game */
+    SHM_WON     = 2, /* All bombs were flagged */
+    SHM_LOST    = 3, /* A bomb was revealed */
+    SHM_ABORTED = 4, /* All tiles were revealed with the 'r' key */
+};
+
+/**
+ * @enum shm_action_types
+ * @brief For ShmAction.type
+ * @details Like the keys, an action on a finished game starts a new one first.
+ */
+enum shm_action_types {
+    SHM_REVEAL   = 0, /* Same as <space> */
+    SHM_FLAG     = 1, /* Same as 'f' */
+    SHM_NEW_GAME = 2, /* Start a new game, ignoring the position */
+};
+
+/**
+ * @struct ShmAction
+ * @brief Move submitted by an external process
+ */
+typedef struct {
+    uint16_t x, y; /* Position of the tile in the grid */
+    uint32_t type; /* See shm_action_types */
+} ShmAction;
+
+/**
+ * @struct ShmBoard
+ * @brief Layout of the shared memory segment created with `--shm`
+ * @details Everything from `game` to the end of `tiles` is only written by the
+ * game, inside a seqlock: `seq` is odd while writing, and increased once more
+ * when done. A reader should copy what it needs between shm_board_read_begin()
+ * and shm_board_read_retry(), and retry if the latter returns true.
+ *
+ * The action queue has a single producer (the external process, which only
+ * writes `tail`) and a single consumer (the game, which only writes `head`).
+ * Once the game has processed an action, `done` is increased in the seqlock,
+ * even if the action didn't change anything.
+ */
+typedef struct {
+    uint32_t magic;   /* SHM_MAGIC, written last */
+    uint32_t version; /* SHM_VERSION */
+    uint16_t w, h;    /* Width and height of the grid */
+
+    _Alignas(64) _Atomic uint64_t seq; /* Seqlock counter */
+    uint64_t game;                     /* Number of games started */
+    uint64_t done;                     /* Number of actions processed */
+    uint32_t state;                    /* See shm_states */
+    uint32_t bombs;                    /* Bombs in the grid, 0 if SHM_READY */
+    uint32_t flagged;                  /* Number of flagged tiles */
+    uint32_t bbbv;                     /* 3BV of the grid, 0 if SHM_READY */
+
+    _Alignas(64) _Atomic uint32_t head; /* Next action read by the game */
+    _Alignas(64) _Atomic uint32_t tail; /* Next action written by the bot */
+    ShmAction actions[SHM_ACTIONS];     /* Indexed modulo SHM_ACTIONS */
+
+    uint8_t tiles[]; /* Observation of each tile, see obs_values */
+} ShmBoard;
+
+/**
+ * @brief Creates the shared memory segment and maps it
+ * @details All the tiles start hidden. Fails with EEXIST if a segment with the
+ * same name already exists, since it could belong to another running game.
+ * @param[in] name Name of the segment for shm_open(), starting with '/'
+ * @param[in] w, h Size of the grid
+ * @return Mapped segment, or NULL on error, with errno set
+ */
+ShmBoard* shm_board_open(const char* name, uint16_t w, uint16_t h);
+
+/**
+ * @brief Unmaps and removes the shared memory segment
+ * @param[in] board Segment returned by shm_board_open()
+ * @param[in] name Same name passed to shm_board_open()
+ */
+void shm_board_close(ShmBoard* board, const char* name);
+
+/**
+ * @brief Starts writing the board, readers will retry until shm_board_end()
+ */
+void shm_board_begin(ShmBoard* board);
+
+/**
+ * @brief Ends writing the board, publishing the changes
+ */
+void shm_board_end(ShmBoard* board);
+
+/**
+ * @brief Returns true if there are actions in the queue
+ */
+bool shm_board_pending(ShmBoard* board);
+
+/**
+ * @brief Removes the oldest action from the queue
+ * @param[in] board Shared segment
+ * @param[out] dst Where to store the action
+ * @return False if the queue was empty
+ */
+bool shm_board_pop(ShmBoard* board, ShmAction* dst);
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Functions for the external process. They don't make any system calls, so a
+ * bot can submit moves and read the board as fast as the game processes them.
+ */
+
+/**
+ * @brief Adds an action to the queue
+ * @return False if the queue is full
+ */
+static inline bool shm_board_push(ShmBoard* board, ShmAction action) {
+    const uint32_t tail = atomic_load_explicit(&board->tail,
+                                               memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&board->head,
+                                               memory_order_acquire);
+    if (tail - head >= SHM_ACTIONS)
+        return false;
+
+    board->actions[tail % SHM_ACTIONS] = action;
+    atomic_store_explicit(&board->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Starts reading the board
+ * @details Waits while the game is writing.
+ * @return Value that should be passed to shm_board_read_retry()
+ */
+static inline uint64_t shm_board_read_begin(ShmBoard* board) {
+    uint64_t seq;
+    while ((seq = atomic_load_explicit(&board->seq, memory_order_acquire)) & 1)
+        ;
+
+    return seq;
+}
+
+/**
+ * @brief Returns true if the board changed while reading it
+ * @details In that case, what was read should be discarded.
+ */
+static inline bool shm_board_read_retry(ShmBoard* board, uint64_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&board->seq, memory_order_relaxed) != seq;
+}
+
+#endif /* _SHM_H */
@@ -0,0 +1,397 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h> /* clock_gettime */
+
+#include "rng.h"
+#include "shm.h" /* obs_values */
+#include "solver.h"
+
+/**
+ * @def PATTERN_SIDE
+ * @brief Width and height of the area around each number used as a pattern
+ */
+#define PATTERN_SIDE 5
+
+/**
+ * @def PATTERN_CELLS
+ * @brief Number of cells in a pattern, each one uses 4 bits of the key
+ */
+#define PATTERN_CELLS (PATTERN_SIDE * PATTERN_SIDE)
+
+/**
+ * @def PATTERN_TABLE_SZ
+ * @brief Number of entries in the pattern table, must be a power of two
+ */
+#define PATTERN_TABLE_SZ (256 * 1024)
+
+/**
+ * @def PATTERN_USED
+ * @brief Bit set in Pattern.hi for the used entries of the table
+ * @details The key only uses the low 36 bits of `hi`.
+ */
+#define PATTERN_USED (1ULL << 63)
+
+/**
+ * @enum pattern_codes
+ * @brief Values of the cells of a pattern, besides the numbers and OBS_HIDDEN
+ * @details Cells that can't change the result share the same code, so more
+ * areas of the board map to the same pattern.
+ */
+enum pattern_codes {
+    PAT_BOMB = OBS_FLAG, /* Revealed bomb */
+    PAT_NONE = 12,       /* Outside the board, or number in the outer ring */
+};
+
+/**
+ * @struct Pattern
+ * @brief Entry of the pattern table
+ */
+typedef struct {
+    uint64_t lo, hi; /* Key, the cells of the pattern with 4 bits each */
+    uint32_t safe;   /* Cells of the pattern that are always safe */
+    uint32_t bomb;   /* Cells of the pattern that always have a bomb */
+} Pattern;
+
+/**
+ * @struct Constraints
+ * @brief State of the local solver used for the patterns that are not in the
+ * table
+ */
+typedef struct {
+    uint32_t vars[9];  /* Hidden cells around each number */
+    int need[9];       /* Bombs that are missing around each number */
+    int num;           /* Number of constraints */
+    uint32_t all;      /* Hidden cells around any number */
+    uint32_t can_bomb; /* Cells that have a bomb in some solution */
+    uint32_t can_safe; /* Cells that are safe in some solution */
+} Constraints;
+
+/**
+ * @var table
+ * @brief Open addressing table with linear probing, allocated when needed
+ */
+static Pattern* table = NULL;
+
+/**
+ * @var table_error
+ * @brief True if the table couldn't be allocated, so it's not retried
+ */
+static bool table_error = false;
+
+/**
+ * @var stats
+ * @brief Counters returned by solver_stats()
+ */
+static SolverStats stats;
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Returns the current time of the monotonic clock in nanoseconds
+ */
+static inline uint64_t now_nsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Returns a mask with the cells around a cell of a pattern
+ */
+static uint32_t cells_around(int k) {
+    const int cx = k % PATTERN_SIDE;
+    const int cy = k / PATTERN_SIDE;
+
+    uint32_t ret = 0;
+    for (int y = cy - 1; y <= cy + 1; y++)
+        for (int x = cx - 1; x <= cx + 1; x++)
+            if (y >= 0 && y < PATTERN_SIDE && x >= 0 && x < PATTERN_SIDE &&
+                (x != cx || y != cy))
+                ret |= 1U << (y * PATTERN_SIDE + x);
+
+    return ret;
+}
+
+/**
+ * @brief Builds the pattern of the area centered at a tile
+ * @details Only the numbers in the inner 3x3 area and the cells around them
+ * are kept, the rest can't change the result (see pattern_solve()).
+ * @param[in] obs Visible board
+ * @param[in] w, h Size of the board
+ * @param[in] cx, cy Center of the area
+ * @param[out] cells Code of each cell (see pattern_codes)
+ * @param[out] lo, hi Key of the pattern
+ */
+static void pattern_key(const uint8_t* obs, int w, int h, int cx, int cy,
+                        uint8_t* cells, uint64_t* lo, uint64_t* hi) {
+    uint32_t used = 0;
+
+    for (int k = 0; k < PATTERN_CELLS; k++) {
+        const int px = k % PATTERN_SIDE;
+        const int py = k / PATTERN_SIDE;
+        const int x  = cx - PATTERN_SIDE / 2 + px;
+        const int y  = cy - PATTERN_SIDE / 2 + py;
+
+        const bool inner = px > 0 && px < PATTERN_SIDE - 1 && py > 0 &&
+                           py < PATTERN_SIDE - 1;
+
+        /* The flags of the user can be wrong, so they are just hidden */
+        if (x < 0 || x >= w || y < 0 || y >= h)
+            cells[k] = PAT_NONE;
+        else if (obs[y * w + x] == OBS_BOMB)
+            cells[k] = PAT_BOMB;
+        else if (obs[y * w + x] == OBS_HIDDEN || obs[y * w + x] == OBS_FLAG)
+            cells[k] = OBS_HIDDEN;
+        else if (inner)
+            cells[k] = obs[y * w + x];
+        else
+            cells[k] = PAT_NONE;
+
+        if (inner && cells[k] <= 8)
+            used |= cells_around(k) | 1U << k;
+    }
+
+    *lo = 0;
+    *hi = 0;
+
+    for (int k = 0; k < PATTERN_CELLS; k++) {
+        if (!(used & (1U << k)))
+            cells[k] = PAT_NONE;
+
+        if (k < 16)
+            *lo |= (uint64_t)cells[k] << (k * 4);
+        else
+            *hi |= (uint64_t)cells[k] << ((k - 16) * 4);
+    }
+}
+
+/**
+ * @brief Returns false if the assigned cells break a constraint of `var`
+ * @param[in] c Constraints
+ * @param[in] left Cells that are not assigned yet
+ * @param[in] bombs Assigned cells with a bomb
+ * @param[in] var Last assigned cell
+ */
+static bool consistent(const Constraints* c, uint32_t left, uint32_t bombs,
+                       int var) {
+    for (int i = 0; i < c->num; i++) {
+        if (!(c->vars[i] & (1U << var)))
+            continue;
+
+        const int placed     = __builtin_popcount(c->vars[i] & bombs);
+        const int unassigned = __builtin_popcount(c->vars[i] & left);
+        if (placed > c->need[i] || placed + unassigned < c->need[i])
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Tries every assignment of the cells in `left`, with backtracking
+ * @details Stops as soon as every cell can be both safe and a bomb, since
+ * nothing can be deduced after that.
+ * @param[inout] c Constraints, the solutions are accumulated here
+ * @param[in] left Cells that are not assigned yet
+ * @param[in] bombs Assigned cells with a bomb
+ */
+static void search(Constraints* c, uint32_t left, uint32_t bombs) {
+    if ((c->can_bomb & c->can_safe) == c->all)
+        return;
+
+    if (left == 0) {
+        c->can_bomb |= bombs;
+        c->can_safe |= c->all & ~bombs;
+        return;
+    }
+
+    const int var = __builtin_ctz(left);
+    left &= left - 1;
+
+    if (consistent(c, left, bombs, var))
+        search(c, left, bombs);
+
+    if (consistent(c, left, bombs | 1U << var, var))
+        search(c, left, bombs | 1U << var);
+}
+
+/**
+ * @brief Solves a pattern, only with the numbers in its inner 3x3 area
+ * @details The numbers in the outer ring have cells around them outside the
+ * pattern, so they are not used. Any solution of the whole board is also a
+ * solution of the pattern, so what holds in every solution of the pattern
+ * holds for the board.
+ * @param[in] cells Code of each cell
+ * @param[out] safe Hidden cells that are always safe
+ * @param[out] bomb Hidden cells that always have a bomb
+ */
+static void pattern_solve(const uint8_t* cells, uint32_t* safe,
+                          uint32_t* bomb) {
+    Constraints c = { .num = 0 };
+
+    *safe = 0;
+    *bomb = 0;
+
+    for (int y = 1; y < PATTERN_SIDE - 1; y++) {
+        for (int x = 1; x < PATTERN_SIDE - 1; x++) {
+            const int k = y * PATTERN_SIDE + x;
+            if (cells[k] > 8)
+                continue;
+
+            const uint32_t around = cells_around(k);
+
+            int need      = cells[k];
+            uint32_t vars = 0;
+            for (int n = 0; n < PATTERN_CELLS; n++) {
+                if (!(around & (1U << n)))
+                    continue;
+
+                if (cells[n] == PAT_BOMB)
+                    need--;
+                else if (cells[n] == OBS_HIDDEN)
+                    vars |= 1U << n;
+            }
+
+            /* Impossible area, there are no valid solutions */
+            if (need < 0 || need > __builtin_popcount(vars))
+                return;
+
+            if (vars == 0)
+                continue;
+
+            c.vars[c.num] = vars;
+            c.need[c.num] = need;
+            c.num++;
+            c.all |= vars;
+        }
+    }
+
+    if (c.all == 0)
+        return;
+
+    search(&c, c.all, 0);
+
+    /* If there were no solutions, both masks are empty */
+    *safe = c.all & c.can_safe & ~c.can_bomb;
+    *bomb = c.all & c.can_bomb & ~c.can_safe;
+}
+
+/**
+ * @brief Returns the solution of a pattern, from the table if possible
+ * @details Patterns that are not in the table are solved with pattern_solve()
+ * and stored, until the table is 3/4 full.
+ * @param[in] cells Code of each cell
+ * @param[in] lo, hi Key of the pattern
+ * @param[out] safe Hidden cells that are always safe
+ * @param[out] bomb Hidden cells that always have a bomb
+ */
+static void pattern_lookup(const uint8_t* cells, uint64_t lo, uint64_t hi,
+                           uint32_t* safe, uint32_t* bomb) {
+    if (table == NULL && !table_error) {
+        table       = calloc(PATTERN_TABLE_SZ, sizeof(Pattern));
+        table_error = table == NULL;
+    }
+
+    hi |= PATTERN_USED;
+
+    const size_t mask = PATTERN_TABLE_SZ - 1;
+
+    size_t i = splitmix64(lo ^ splitmix64(hi)) & mask;
+    if (table != NULL) {
+        /* There are always empty entries, so this ends */
+        for (; table[i].hi & PATTERN_USED; i = (i + 1) & mask) {
+            if (table[i].lo == lo && table[i].hi == hi) {
+                *safe = table[i].safe;
+                *bomb = table[i].bomb;
+                stats.hits++;
+                return;
+            }
+        }
+    }
+
+    const uint64_t start = now_nsecs();
+    pattern_solve(cells, safe, bomb);
+    stats.solve_nsecs += now_nsecs() - start;
+    stats.misses++;
+
+    if (table != NULL && stats.entries < PATTERN_TABLE_SZ / 4 * 3) {
+        table[i] = (Pattern){
+            .lo   = lo,
+            .hi   = hi,
+            .safe = *safe,
+            .bomb = *bomb,
+        };
+        stats.entries++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+
+bool solver_hint(const uint8_t* obs, int w, int h, int near_x, int near_y,
+                 SolverHint* dst) {
+    bool found    = false;
+    int best_dist = 0;
+
+    uint8_t cells[PATTERN_CELLS];
+
+    for (int cy = 0; cy < h; cy++) {
+        for (int cx = 0; cx < w; cx++) {
+            if (obs[cy * w + cx] > 8)
+                continue;
+
+            /* Only numbers in the frontier can tell something new */
+            bool frontier = false;
+            for (int y = cy - 1; y <= cy + 1 && !frontier; y++)
+                for (int x = cx - 1; x <= cx + 1 && !frontier; x++)
+                    if (y >= 0 && y < h && x >= 0 && x < w &&
+                        (obs[y * w + x] == OBS_HIDDEN ||
+                         obs[y * w + x] == OBS_FLAG))
+                        frontier = true;
+
+            if (!frontier)
+                continue;
+
+            uint64_t lo, hi;
+            pattern_key(obs, w, h, cx, cy, cells, &lo, &hi);
+
+            uint32_t safe, bomb;
+            pattern_lookup(cells, lo, hi, &safe, &bomb);
+
+            for (uint32_t bits = safe | bomb; bits != 0; bits &= bits - 1) {
+                const int k = __builtin_ctz(bits);
+                const int x = cx - PATTERN_SIDE / 2 + k % PATTERN_SIDE;
+                const int y = cy - PATTERN_SIDE / 2 + k / PATTERN_SIDE;
+
+                const bool is_bomb = (bomb >> k) & 1;
+                const int dist     = abs(x - near_x) + abs(y - near_y);
+
+                /* Flagged bombs are already known */
+                if (is_bomb && obs[y * w + x] == OBS_FLAG)
+                    continue;
+
+                /* Safe tiles first, then the closest one */
+                if (found && (is_bomb > dst->bomb ||
+                              (is_bomb == dst->bomb && dist >= best_dist)))
+                    continue;
+
+                *dst      = (SolverHint){ .x = x, .y = y, .bomb = is_bomb };
+                best_dist = dist;
+                found     = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+SolverStats solver_stats(void) {
+    return stats;
+}
+
+void solver_free(void) {
+    free(table);
+    table = NULL;
+}
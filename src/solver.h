@@ -0,0 +1,55 @@
+#ifndef _SOLVER_H
+#define _SOLVER_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @struct SolverHint
+ * @brief Tile deduced by solver_hint()
+ */
+typedef struct {
+    int x, y;  /* Position of the tile */
+    bool bomb; /* True if the tile has a bomb, false if it's safe */
+} SolverHint;
+
+/**
+ * @struct SolverStats
+ * @brief Counters of the pattern table, since the program started
+ */
+typedef struct {
+    uint64_t hits;        /* Patterns found in the table */
+    uint64_t misses;      /* Patterns that had to be solved */
+    uint64_t entries;     /* Patterns stored in the table */
+    uint64_t solve_nsecs; /* Total time spent solving the misses */
+} SolverStats;
+
+/**
+ * @brief Finds a hidden tile that is certainly safe, or certainly a bomb
+ * @details Each revealed number next to hidden tiles is solved with the 5x5
+ * area around it: only the numbers in its inner 3x3 area are used, since the
+ * whole area around them is known. Flags are not trusted, since they can be
+ * wrong, so a flagged tile can be returned as safe. The result of each area
+ * depends only on its visible tiles, so it's stored in a table and reused when
+ * the same pattern appears again. Safe tiles are preferred, and the closest
+ * one to the specified position is returned.
+ * @param[in] obs Visible board, a byte per tile (see obs_values in shm.h)
+ * @param[in] w, h Size of the board
+ * @param[in] near_x, near_y Position used for choosing between several tiles
+ * @param[out] dst Deduced tile
+ * @return False if nothing can be deduced from the patterns
+ */
+bool solver_hint(const uint8_t* obs, int w, int h, int near_x, int near_y,
+                 SolverHint* dst);
+
+/**
+ * @brief Returns the counters of the pattern table
+ */
+SolverStats solver_stats(void);
+
+/**
+ * @brief Frees the pattern table
+ */
+void solver_free(void);
+
+#endif /* _SOLVER_H */